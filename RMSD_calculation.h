@@ -1,20 +1,31 @@
 #ifndef RMSD_CALCULATION_H
 #define RMSD_CALCULATION_H
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include <string>
 #include <eigen3/Eigen/Geometry>
 
+#include "coarse_screening.h"
 #include "globals.h"
+#include "resident_cache.h"
+#include "sphere_kernels.h"
+#include "trajectory.h"
 
 class RMSDCalculation {
   private:
 
     // calculating distance between 2 atoms, used when allocating atoms to spheres.
-    double atomsDistanceCalc(int atom1, int atom2) {
+    double atomsDistanceCalc(const CoordinateStore &store, int frame, int atom1, int atom2) {
 
-        double dx = A[FRAMEONE][atom1][0] - A[FRAMEONE][atom2][0];
-        double dy = A[FRAMEONE][atom1][1] - A[FRAMEONE][atom2][1];
-        double dz = A[FRAMEONE][atom1][2] - A[FRAMEONE][atom2][2];
+        double dx = store.at(frame, atom1, 0) - store.at(frame, atom2, 0);
+        double dy = store.at(frame, atom1, 1) - store.at(frame, atom2, 1);
+        double dz = store.at(frame, atom1, 2) - store.at(frame, atom2, 2);
 
         double result = dx*dx + dy*dy + dz*dz;
 
@@ -109,13 +120,290 @@ class RMSDCalculation {
         }
     }
 
+  public:
+    // atoms within sphereRadius + skin of every CA on sourceFrame
+    struct SkinList {
+        int sourceFrame;
+        long lastUse;
+        std::vector<std::vector<int>> candidates;
+    };
+
+    // state of one search thread, aligned so that threads never share a cache line
+    struct alignas(64) ThreadState {
+        int frameOne;
+        int frameTwo;
+        // List of atoms in [<sphere>]
+        std::vector<std::vector<int>> sphereAtoms;
+        // neighbour lists of the last few source frames, least recently used is rebuilt first
+        std::vector<SkinList> skinLists;
+        long skinUses;
+        int skinReused;
+        int skinRebuilt;
+        // counters are atomic only so that stats can be read while the search runs
+        std::atomic<long> rmsdCalculations;
+        std::atomic<long> allocations;
+        std::atomic<long> screened;
+        // resident cache lookups and hits, of pair values and of allocations
+        std::atomic<long> valueLookups;
+        std::atomic<long> valueHits;
+        std::atomic<long> allocationLookups;
+        std::atomic<long> allocationHits;
+        // RMSD of every sphere of the current pair, summed in sphere order once all are calculated
+        std::vector<double> sphereValues;
+        // with several radii: atoms within the largest radius of every sphere in ascending order, with the index
+        // of the smallest radius each atom is within, and RMSD of every sphere for every radius as [<sphere>][<radius>]
+        std::vector<std::vector<int>> radiusAtoms;
+        std::vector<std::vector<unsigned char>> radiusLevels;
+        std::vector<double> radiusValues;
+        // best pair of every radius over pairs evaluated by this thread
+        std::vector<double> radiusMax;
+        std::vector<int> radiusMaxI;
+        std::vector<int> radiusMaxJ;
+        // running per-sphere maximum over pairs evaluated by this thread, and the pair it was found on
+        std::vector<double> sphereMax;
+        std::vector<int> sphereMaxI;
+        std::vector<int> sphereMaxJ;
+
+        ThreadState() : frameOne(0), frameTwo(0), skinUses(0), skinReused(0), skinRebuilt(0),
+                        rmsdCalculations(0), allocations(0), screened(0),
+                        valueLookups(0), valueHits(0), allocationLookups(0), allocationHits(0) {}
+    };
+
+  private:
+    const Trajectory &trajectory;
+    const CoordinateStore &A;
+
+    std::unique_ptr<ThreadState[]> threads;
+    int threadsCount;
+    double skin;
+    // neighbour lists kept by every thread: routes switch sides and come back to frames they allocated on
+    static const int SKIN_LISTS = 8;
+
+    inline ThreadState &state() {
+        return threads[omp_thread_id];
+    }
+
+    // only the owning thread writes its counters
+    static inline void increment(std::atomic<long> &counter) {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // true if no atom moved more than skin / 2 between frames, so every atom within sphereRadius
+    // on frame2 is within sphereRadius + skin on frame1
+    bool withinSkin(int frame1, int frame2) {
+        double maxDisplacement2 = skin * skin / 4;
+        for (int i = 0; i < trajectory.atoms; i++) {
+            double dx = A.at(frame1, i, 0) - A.at(frame2, i, 0);
+            double dy = A.at(frame1, i, 1) - A.at(frame2, i, 1);
+            double dz = A.at(frame1, i, 2) - A.at(frame2, i, 2);
+            if (dx*dx + dy*dy + dz*dz >= maxDisplacement2) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // list built on frameOne itself, or else on the nearest source frame atoms did not leave the skin from; null if none is
+    SkinList *findSkinList(ThreadState &thread) {
+        SkinList *found = nullptr;
+        for (SkinList &list : thread.skinLists) {
+            if (list.sourceFrame == thread.frameOne) {
+                return &list;
+            }
+            if (found && std::abs(list.sourceFrame - thread.frameOne) >= std::abs(found->sourceFrame - thread.frameOne)) {
+                continue;
+            }
+            if (withinSkin(list.sourceFrame, thread.frameOne)) {
+                found = &list;
+            }
+        }
+        return found;
+    }
+
+    // allocating from neighbour lists, building them on frameOne only when no kept list fits,
+    // in place of the least recently used one once SKIN_LISTS are kept
+    void atomsAllocationWithSkin(ThreadState &thread) {
+        SkinList *list = findSkinList(thread);
+        if (list) {
+            thread.skinReused++;
+        } else {
+            if ((int)thread.skinLists.size() < SKIN_LISTS) {
+                thread.skinLists.emplace_back();
+                list = &thread.skinLists.back();
+            } else {
+                list = &*std::min_element(thread.skinLists.begin(), thread.skinLists.end(),
+                                          [](const SkinList &a, const SkinList &b) { return a.lastUse < b.lastUse; });
+            }
+            list->sourceFrame = thread.frameOne;
+            thread.skinRebuilt++;
+            double skinRadius = std::max(sphereRadius, radii.back()) + skin;
+            list->candidates.assign(trajectory.spheres, {});
+            int node = omp_numa_node;
+#pragma omp parallel for schedule(static) num_threads(intraPairThreads) if (intraPairThreads > 1) firstprivate(node)
+            for (int j = 0; j < trajectory.spheres; j++) {
+                omp_numa_node = node;
+                for (int i = 0; i < trajectory.atoms; i++) {
+                    if (atomsDistanceCalc(A, thread.frameOne, i, trajectory.sphereCA[j]) <= skinRadius) {
+                        list->candidates[j].push_back(i);
+                    }
+                }
+            }
+        }
+        list->lastUse = ++thread.skinUses;
+        const std::vector<std::vector<int>> &candidates = list->candidates;
+        // candidates are in ascending atom order, so spheres are the same as from a full scan
+        clearSpheres(thread);
+        int node = omp_numa_node;
+#pragma omp parallel for schedule(static) num_threads(intraPairThreads) if (intraPairThreads > 1) firstprivate(node)
+        for (int j = 0; j < trajectory.spheres; j++) {
+            omp_numa_node = node;
+            for (int i : candidates[j]) {
+                assignAtom(thread, j, i, atomsDistanceCalc(A, thread.frameOne, i, trajectory.sphereCA[j]));
+            }
+        }
+    }
+
+    // checking every atom against every CA on frameOne; spheres are independent, so they are split
+    // between intraPairThreads threads, each sphere keeping atoms in ascending order
+    void atomsAllocationFull(ThreadState &thread, const CoordinateStore &store) {
+        int firstFrame = thread.frameOne;
+        clearSpheres(thread);
+        int node = omp_numa_node;
+#pragma omp parallel for schedule(static) num_threads(intraPairThreads) if (intraPairThreads > 1) firstprivate(node)
+        for (int j = 0; j < trajectory.spheres; j++) {
+            // nested threads read the coordinates copy of the search thread
+            omp_numa_node = node;
+            for (int i = 0; i < trajectory.atoms; i++) {
+                assignAtom(thread, j, i, atomsDistanceCalc(store, firstFrame, i, trajectory.sphereCA[j]));
+            }
+        }
+    }
+
+    inline bool multiRadius() const {
+        return radii.size() > 1;
+    }
+
+    // cached values and allocations hold only the sphereRadius spheres, a hit would leave the radius levels
+    // of the previous frame, so with several radii the cache is neither read nor written
+    inline bool cacheUsed() const {
+        return cache && !multiRadius();
+    }
+
+    // a cached value skips the sphere loop, so per-sphere maxima would miss the pair; values are still stored
+    inline bool cachedValuesRead() const {
+        return cacheUsed() && !trackSpheres;
+    }
+
+    void clearSpheres(ThreadState &thread) {
+        thread.sphereAtoms.assign(trajectory.spheres, {});
+        if (multiRadius()) {
+            thread.radiusAtoms.assign(trajectory.spheres, {});
+            thread.radiusLevels.assign(trajectory.spheres, {});
+        }
+    }
+
+    // atom at distance from the CA of sphere j joins the sphere of sphereRadius, and with several radii
+    // the list of the largest one, tagged with the smallest radius it is within
+    inline void assignAtom(ThreadState &thread, int j, int atom, double distance) {
+        if (distance <= sphereRadius) {
+            thread.sphereAtoms[j].push_back(atom);
+        }
+        if (multiRadius() && distance <= radii.back()) {
+            unsigned char level = 0;
+            while (distance > radii[level]) {
+                level++;
+            }
+            thread.radiusAtoms[j].push_back(atom);
+            thread.radiusLevels[j].push_back(level);
+        }
+    }
+    // RMSD of one sphere between frameOne and frameTwo, with atoms superposed using dynamic size matrices
+    double sphereRMSDDynamic(const CoordinateStore &store, const ThreadState &thread, const std::vector<int> &atoms,
+                             std::vector<std::vector<std::vector<double>>> &sphereMatrix) {
+        int atomsInSphere = atoms.size();
+        sphereMatrix.assign(2, {});
+        sphereMatrix[0].assign(atomsInSphere, std::vector<double>(3));
+        sphereMatrix[1].assign(atomsInSphere, std::vector<double>(3));
+
+        for (int j = 0; j < atomsInSphere; j++) {
+            for (int k = 0; k < 3; k++) {
+                sphereMatrix[0][j][k] = store.at(thread.frameOne, atoms[j], k);
+                sphereMatrix[1][j][k] = store.at(thread.frameTwo, atoms[j], k);
+            }
+        }
+        double tempResult = 0;
+        superpose(sphereMatrix[0], sphereMatrix[1]);
+        for (int j = 0; j < atomsInSphere; j++) {
+            for (int k = 0; k < 3; k++ ) {
+                double tempRMSD = sphereMatrix[1][j][k] - sphereMatrix[0][j][k];
+                tempResult += tempRMSD * tempRMSD;
+            }
+        }
+        tempResult /= atomsInSphere * 3.0;
+        return sqrt(tempResult);
+    }
+
+    // store is A, except when comparing A with its quantised copy
+    inline double sphereRMSD(const CoordinateStore &store, const ThreadState &thread, int sphere,
+                             std::vector<std::vector<std::vector<double>>> &sphereMatrix) {
+        const std::vector<int> &atoms = thread.sphereAtoms[sphere];
+        double result = -1.0;
+        if (fixedSizeKernels && store.quantised()) {
+            result = sphereRMSDBucketed(atoms, store.quantisedFrame(thread.frameOne), store.quantisedFrame(thread.frameTwo));
+        } else if (fixedSizeKernels) {
+            result = sphereRMSDBucketed(atoms, store[thread.frameOne], store[thread.frameTwo]);
+        }
+        if (result < 0) {
+            result = sphereRMSDDynamic(store, thread, atoms, sphereMatrix);
+        }
+        return result;
+    }
+
+    inline double sphereRMSD(const ThreadState &thread, int sphere, std::vector<std::vector<std::vector<double>>> &sphereMatrix) {
+        return sphereRMSD(A, thread, sphere, sphereMatrix);
+    }
+
+    // RMSD of one sphere for every radius, returns the one of sphereRadius
+    inline double sphereRMSDRadii(ThreadState &thread, int sphere) {
+        double *values = &thread.radiusValues[(size_t)sphere * radii.size()];
+        if (A.quantised()) {
+            ::sphereRMSDRadii(thread.radiusAtoms[sphere], thread.radiusLevels[sphere], radii.size(), A.quantisedFrame(thread.frameOne),
+                              A.quantisedFrame(thread.frameTwo), values);
+        } else {
+            ::sphereRMSDRadii(thread.radiusAtoms[sphere], thread.radiusLevels[sphere], radii.size(), A[thread.frameOne],
+                              A[thread.frameTwo], values);
+        }
+        return values[primaryRadius];
+    }
+
+    // sums of every radius in sphere order, kept as the thread's best pair of the radius if higher
+    void recordRadii(ThreadState &thread) {
+        for (size_t r = 0; r < radii.size(); r++) {
+            double sum = 0;
+            for (int s = 0; s < trajectory.spheres; s++) {
+                sum += thread.radiusValues[(size_t)s * radii.size() + r];
+            }
+            if (sum > thread.radiusMax[r]) {
+                thread.radiusMax[r] = sum;
+                thread.radiusMaxI[r] = thread.frameOne;
+                thread.radiusMaxJ[r] = thread.frameTwo;
+            }
+        }
+    }
+
+    // pairs already calculated during current search, shared by all threads of one search
+    std::unordered_set<std::pair<int, int>, PairHash> memorySet;
+    omp_lock_t memoryMutex;
+    bool useMemory;
+    int memoryCapacity;
+
     bool pairInMemory(int f1, int f2) {
         omp_set_lock(&memoryMutex);
         std::pair<int, int> newPair = std::make_pair(f1, f2);
         if (memorySet.find(newPair) == memorySet.end()) {
             // not in memory
             memorySet.insert(newPair);
-            if (memorySet.size() > MEMORY_SIZE) {
+            if ((int)memorySet.size() > memoryCapacity) {
                 memorySet.erase(memorySet.begin());
             }
             omp_unset_lock(&memoryMutex);
@@ -128,57 +416,369 @@ class RMSDCalculation {
     }
 
   public:
+    CoarseScreening coarse;
+    // shared by searches on the same trajectory, null if disabled; not used with several radii
+    std::shared_ptr<ResidentCache> cache;
+    // spheres up to 256 atoms are calculated with compile-time sized kernels
+    bool fixedSizeKernels;
+    // keeping per-sphere maxima in thread buffers, set before initThreads()
+    bool trackSpheres;
+    // threads of a nested team splitting the spheres of one pair, 1 to calculate pairs on the search thread only
+    int intraPairThreads;
+    // atoms within sphereRadius angstroms of a CA form its sphere
+    double sphereRadius;
+    // ascending radii scored together with sphereRadius, which is one of them; only sphereRadius with one radius
+    std::vector<double> radii;
+    // index of sphereRadius in radii
+    int primaryRadius;
+
+    RMSDCalculation(const Trajectory &trajectory)
+        : trajectory(trajectory), A(trajectory.A), threadsCount(0), skin(0), useMemory(false), memoryCapacity(0),
+          coarse(trajectory), fixedSizeKernels(true), trackSpheres(false), intraPairThreads(1),
+          sphereRadius(8), radii(1, 8), primaryRadius(0) {
+        omp_init_lock(&memoryMutex);
+    }
+
+    ~RMSDCalculation() {
+        omp_destroy_lock(&memoryMutex);
+    }
+
+    // comma separated list together with radius, ascending and without repeats; false if radius or an item
+    // is not a positive number, or there are more than MAX_RADII radii
+    static bool parseRadii(const std::string &list, double radius, std::vector<double> &result) {
+        result.assign(1, radius);
+        if (!(radius > 0)) {
+            return false;
+        }
+        size_t from = 0;
+        while (from <= list.size()) {
+            size_t to = std::min(list.find(',', from), list.size());
+            std::string item = list.substr(from, to - from);
+            from = to + 1;
+            if (item.find_first_not_of(" \t") == std::string::npos) {
+                continue;
+            }
+            char *end;
+            double value = strtod(item.c_str(), &end);
+            while (*end == ' ' || *end == '\t') {
+                end++;
+            }
+            if (end == item.c_str() || *end != '\0' || !(value > 0) || !std::isfinite(value)) {
+                return false;
+            }
+            result.push_back(value);
+        }
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+        return (int)result.size() <= MAX_RADII;
+    }
+
+    // radius of the search and every radius scored in the same pass, as given by parseRadii(); set before initThreads()
+    void setRadii(double radius, const std::vector<double> &allRadii) {
+        sphereRadius = radius;
+        radii = allRadii;
+        primaryRadius = std::find(radii.begin(), radii.end(), radius) - radii.begin();
+    }
+
+    // memorySize is a fraction of matrixSize by matrixSize pairs to remember
+    void initMemory(double memorySize, int matrixSize) {
+        useMemory = memorySize != 0;
+        memoryCapacity = matrixSize * matrixSize * memorySize;
+        memorySet.clear();
+    }
+
+    // one state for every thread id of the search; skinWidth > 0 enables reusing
+    // neighbour lists between allocations on nearby frames
+    void initThreads(int threadsNumber, double skinWidth) {
+        skin = skinWidth;
+        threadsCount = threadsNumber;
+        threads.reset(new ThreadState[threadsCount]);
+        for (int t = 0; trackSpheres && t < threadsCount; t++) {
+            threads[t].sphereMax.assign(trajectory.spheres, -1.0);
+            threads[t].sphereMaxI.assign(trajectory.spheres, -1);
+            threads[t].sphereMaxJ.assign(trajectory.spheres, -1);
+        }
+        for (int t = 0; multiRadius() && t < threadsCount; t++) {
+            threads[t].radiusValues.assign((size_t)trajectory.spheres * radii.size(), 0.0);
+            threads[t].radiusMax.assign(radii.size(), -1.0);
+            threads[t].radiusMaxI.assign(radii.size(), -1);
+            threads[t].radiusMaxJ.assign(radii.size(), -1);
+        }
+    }
+
+    // best pair of every radius merged over all threads, read once the search is over
+    void radiusMaxima(std::vector<double> &values, std::vector<int> &i, std::vector<int> &j) {
+        values.assign(radii.size(), -1.0);
+        i.assign(radii.size(), -1);
+        j.assign(radii.size(), -1);
+        for (int t = 0; multiRadius() && t < threadsCount; t++) {
+            for (size_t r = 0; r < radii.size(); r++) {
+                if (threads[t].radiusMax[r] > values[r]) {
+                    values[r] = threads[t].radiusMax[r];
+                    i[r] = threads[t].radiusMaxI[r];
+                    j[r] = threads[t].radiusMaxJ[r];
+                }
+            }
+        }
+    }
+
+    // per-sphere maxima merged over all threads, read once the search is over
+    void sphereMaxima(std::vector<double> &values, std::vector<int> &i, std::vector<int> &j) {
+        values.assign(trajectory.spheres, -1.0);
+        i.assign(trajectory.spheres, -1);
+        j.assign(trajectory.spheres, -1);
+        for (int t = 0; trackSpheres && t < threadsCount; t++) {
+            for (int s = 0; s < trajectory.spheres; s++) {
+                if (threads[t].sphereMax[s] > values[s]) {
+                    values[s] = threads[t].sphereMax[s];
+                    i[s] = threads[t].sphereMaxI[s];
+                    j[s] = threads[t].sphereMaxJ[s];
+                }
+            }
+        }
+    }
+
+    // RMSD of every sphere of pair (frameOne, frameTwo), spheres allocated on frameOne as in the search;
+    // uses own state, so it does not touch counters or allocations of any thread
+    std::vector<double> sphereRMSDs(int frameOne, int frameTwo) {
+        ThreadState scratch;
+        scratch.frameOne = frameOne;
+        atomsAllocationFull(scratch, A);
+        scratch.frameTwo = frameTwo;
+        std::vector<std::vector<std::vector<double>>> sphereMatrix;
+        std::vector<double> result(trajectory.spheres);
+        for (int s = 0; s < trajectory.spheres; s++) {
+            result[s] = sphereRMSD(scratch, s, sphereMatrix);
+        }
+        return result;
+    }
+
+    // allocations served from neighbour lists and allocations which had to rebuild them
+    void skinStats(int &reused, int &rebuilt) {
+        reused = 0;
+        rebuilt = 0;
+        for (int t = 0; t < threadsCount; t++) {
+            reused += threads[t].skinReused;
+            rebuilt += threads[t].skinRebuilt;
+        }
+    }
+
+    // counters summed over all threads, safe to call while the search runs
+    void counters(long &rmsdCalculations, long &allocations, long &screened) {
+        rmsdCalculations = 0;
+        allocations = 0;
+        screened = 0;
+        for (int t = 0; t < threadsCount; t++) {
+            rmsdCalculations += threads[t].rmsdCalculations.load(std::memory_order_relaxed);
+            allocations += threads[t].allocations.load(std::memory_order_relaxed);
+            screened += threads[t].screened.load(std::memory_order_relaxed);
+        }
+    }
+
+    // resident cache lookups and hits summed over all threads
+    void cacheCounters(long &valueLookups, long &valueHits, long &allocationLookups, long &allocationHits) {
+        valueLookups = 0;
+        valueHits = 0;
+        allocationLookups = 0;
+        allocationHits = 0;
+        for (int t = 0; t < threadsCount; t++) {
+            valueLookups += threads[t].valueLookups.load(std::memory_order_relaxed);
+            valueHits += threads[t].valueHits.load(std::memory_order_relaxed);
+            allocationLookups += threads[t].allocationLookups.load(std::memory_order_relaxed);
+            allocationHits += threads[t].allocationHits.load(std::memory_order_relaxed);
+        }
+    }
+
     // calculating RMSD on spheres, on choosen frames
-    double calculateRMSDSuperpose(int secondFrame) {
-        if (config.memorySize != 0 && pairInMemory(FRAMEONE, FRAMETWO)) {
+    // with coarse screening enabled, pairs with no chance to get close to threshold are skipped (-1.0)
+    double calculateRMSDSuperpose(int secondFrame, double threshold = -1) {
+        ThreadState &thread = state();
+        if (useMemory && pairInMemory(thread.frameOne, thread.frameTwo)) {
             return -1.0;
         }
         // else calculate rmsd
-        FRAMETWO = secondFrame;
-        RMSDCalculationCount++;
-        debugRMSD();
+        thread.frameTwo = secondFrame;
+        if (cachedValuesRead()) {
+            increment(thread.valueLookups);
+            double cached;
+            if (cache->findValue(thread.frameOne, thread.frameTwo, cached)) {
+                increment(thread.valueHits);
+                return cached;
+            }
+        }
+        double coarseScore = 0;
+        if (coarse.enabled) {
+            coarseScore = coarse.score(thread.frameOne, thread.frameTwo);
+            if (!coarse.worthEvaluating(coarseScore, threshold)) {
+                increment(thread.screened);
+                return -1.0;
+            }
+        }
+        increment(thread.rmsdCalculations);
+        debugRMSD(thread.rmsdCalculations.load(std::memory_order_relaxed));
+        thread.sphereValues.resize(trajectory.spheres);
+        int node = omp_numa_node;
+#pragma omp parallel num_threads(intraPairThreads) if (intraPairThreads > 1) firstprivate(node)
+        {
+            omp_numa_node = node;
+            std::vector<std::vector<std::vector<double>>> sphereMatrix;
+#pragma omp for schedule(dynamic, 16)
+            for (int s = 0; s < trajectory.spheres; s++) {
+                double tempResult = multiRadius() ? sphereRMSDRadii(thread, s) : sphereRMSD(thread, s, sphereMatrix);
+                if (trackSpheres && tempResult > thread.sphereMax[s]) {
+                    thread.sphereMax[s] = tempResult;
+                    thread.sphereMaxI[s] = thread.frameOne;
+                    thread.sphereMaxJ[s] = thread.frameTwo;
+                }
+                thread.sphereValues[s] = tempResult;
+            }
+        }
+        // the same order of additions as on one thread, so the value does not depend on intraPairThreads
         double result = 0;
+        for (int s = 0; s < trajectory.spheres; s++) {
+            result += thread.sphereValues[s];
+        }
+        if (multiRadius()) {
+            recordRadii(thread);
+        }
+        if (coarse.enabled) {
+            coarse.calibrate(coarseScore, result);
+        }
+        if (cacheUsed()) {
+            cache->storeValue(thread.frameOne, thread.frameTwo, result);
+        }
+        return result;
+    }
+
+    // comparing fixed size kernels with the dynamic path for every sphere size bucket,
+    // spheres are allocated on frame 0 and compared with `pairs` following frames
+    void benchmarkKernels(int pairs) {
+        atomsAllocation(0);
+        ThreadState &thread = state();
+        std::vector<int> buckets = {32, 64, 128, 256, 0};
         std::vector<std::vector<std::vector<double>>> sphereMatrix;
-        for (int s = 0; s < SPHERES; s++) {
-            int atomsInSphere = sphereAtoms[omp_thread_id][s].size();
-            sphereMatrix.assign(2, {});
-            sphereMatrix[0].assign(atomsInSphere, {});
-            sphereMatrix[1].assign(atomsInSphere, {});
-
-            for (int j = 0; j < atomsInSphere; j++) {
-                sphereMatrix[0][j] = A[FRAMEONE][sphereAtoms[omp_thread_id][s][j]];
-                sphereMatrix[1][j] = A[FRAMETWO][sphereAtoms[omp_thread_id][s][j]];
-            }
-            double tempResult = 0;
-            superpose(sphereMatrix[0], sphereMatrix[1]);
-            for (int j = 0; j < atomsInSphere; j++) {
-                for (int k = 0; k < 3; k++ ) {
-                    double tempRMSD = sphereMatrix[1][j][k] - sphereMatrix[0][j][k];
-                    tempResult += tempRMSD * tempRMSD;
+        std::cout << "bucket;spheres;avgAtoms;dynamicNsPerSphere;fixedNsPerSphere;speedup;maxAbsDiff" << std::endl;
+        for (int bucket : buckets) {
+            std::vector<int> spheres;
+            double atomsSum = 0;
+            for (int s = 0; s < trajectory.spheres; s++) {
+                if (sphereBucket(thread.sphereAtoms[s].size()) == bucket) {
+                    spheres.push_back(s);
+                    atomsSum += thread.sphereAtoms[s].size();
+                }
+            }
+            if (spheres.empty()) {
+                continue;
+            }
+            std::vector<double> dynamicResults, fixedResults;
+            auto dynamicStart = std::chrono::steady_clock::now();
+            for (int p = 0; p < pairs; p++) {
+                thread.frameTwo = 1 + p % std::max(trajectory.frames - 1, 1);
+                for (int s : spheres) {
+                    dynamicResults.push_back(sphereRMSDDynamic(A, thread, thread.sphereAtoms[s], sphereMatrix));
+                }
+            }
+            std::chrono::duration<double> dynamicElapsed = std::chrono::steady_clock::now() - dynamicStart;
+            auto fixedStart = std::chrono::steady_clock::now();
+            for (int p = 0; p < pairs; p++) {
+                thread.frameTwo = 1 + p % std::max(trajectory.frames - 1, 1);
+                for (int s : spheres) {
+                    const std::vector<int> &atoms = thread.sphereAtoms[s];
+                    fixedResults.push_back(A.quantised()
+                                               ? sphereRMSDBucketed(atoms, A.quantisedFrame(thread.frameOne), A.quantisedFrame(thread.frameTwo))
+                                               : sphereRMSDBucketed(atoms, A[thread.frameOne], A[thread.frameTwo]));
+                }
+            }
+            std::chrono::duration<double> fixedElapsed = std::chrono::steady_clock::now() - fixedStart;
+            double maxDiff = 0;
+            for (size_t r = 0; r < dynamicResults.size(); r++) {
+                if (fixedResults[r] >= 0) {
+                    maxDiff = std::max(maxDiff, std::abs(dynamicResults[r] - fixedResults[r]));
                 }
             }
-            tempResult /= atomsInSphere * 3.0;
-            tempResult = sqrt(tempResult);
-            result += tempResult;
+            double calls = (double)pairs * spheres.size();
+            double dynamicNs = dynamicElapsed.count() * 1e9 / calls;
+            double fixedNs = fixedElapsed.count() * 1e9 / calls;
+            std::cout << (bucket ? std::to_string(bucket) : "dynamic") << ";" << spheres.size() << ";"
+                      << atomsSum / spheres.size() << ";" << dynamicNs << ";" << fixedNs << ";"
+                      << dynamicNs / fixedNs << ";" << maxDiff << std::endl;
         }
-        return result;
     }
 
-    // allocating atoms into spheres, based on sphereRadius
+    // RMSD sums of `pairs` pairs spread over the trajectory, from A (double) and from its quantised copy.
+    // sameSpheresDifference uses spheres allocated on the doubles for both, so it is the error of the kernels,
+    // which is at most maxBound (sum over spheres of the atom errors of both frames) for rigid superposition.
+    // maxDifference allocates spheres on each store's own coordinates, as a search does, so it adds atoms
+    // lying within the coordinate error of the sphere radius which change spheres
+    void quantisationError(const CoordinateStore &quantised, int pairs, double &sameSpheresDifference, double &maxDifference,
+                           double &maxRelative, double &maxBound) {
+        sameSpheresDifference = 0;
+        maxDifference = 0;
+        maxRelative = 0;
+        maxBound = 0;
+        int frames = trajectory.frames;
+        std::vector<std::vector<std::vector<double>>> sphereMatrix;
+        for (int p = 0; p < pairs && frames > 1; p++) {
+            ThreadState exact, decoded;
+            exact.frameOne = (long)p * frames / pairs;
+            exact.frameTwo = (exact.frameOne + frames / 2 + p) % frames;
+            if (exact.frameTwo == exact.frameOne) {
+                exact.frameTwo = (exact.frameOne + 1) % frames;
+            }
+            decoded.frameOne = exact.frameOne;
+            decoded.frameTwo = exact.frameTwo;
+            atomsAllocationFull(exact, A);
+            atomsAllocationFull(decoded, quantised);
+            double exactSum = 0, decodedSum = 0, sameSpheresSum = 0;
+            for (int s = 0; s < trajectory.spheres; s++) {
+                exactSum += sphereRMSD(A, exact, s, sphereMatrix);
+                decodedSum += sphereRMSD(quantised, decoded, s, sphereMatrix);
+                sameSpheresSum += sphereRMSD(quantised, exact, s, sphereMatrix);
+            }
+            sameSpheresDifference = std::max(sameSpheresDifference, std::abs(exactSum - sameSpheresSum));
+            double difference = std::abs(exactSum - decodedSum);
+            maxDifference = std::max(maxDifference, difference);
+            maxRelative = std::max(maxRelative, exactSum > 0 ? difference / exactSum : 0);
+            double bound = trajectory.spheres * (quantised.maxError(exact.frameOne) + quantised.maxError(exact.frameTwo));
+            maxBound = std::max(maxBound, bound);
+        }
+    }
+
+    // allocating atoms into spheres, based on sphereRadius (and every radius of radii)
     void atomsAllocation(int firstFrame) {
-        FRAMEONE = firstFrame;
-        AllocationsCount++;
-        std::vector<int> temp;
-        temp.reserve(ATOMS);
-        sphereAtoms[omp_thread_id].assign(SPHERES, temp);
-        for (int i = 0; i < ATOMS; i++) {
-            for (int j = 0; j < SPHERES; j++) {
-                if (atomsDistanceCalc(i, sphereCA[j]) <= sphereRadius) {
-                    sphereAtoms[omp_thread_id][j].push_back(i);
-                }
+        ThreadState &thread = state();
+        thread.frameOne = firstFrame;
+        increment(thread.allocations);
+        if (cacheUsed()) {
+            increment(thread.allocationLookups);
+            std::shared_ptr<const ResidentCache::Allocation> cached = cache->findAllocation(firstFrame);
+            if (cached) {
+                increment(thread.allocationHits);
+                thread.sphereAtoms = *cached;
+                return;
             }
         }
+        if (skin > 0) {
+            atomsAllocationWithSkin(thread);
+        } else {
+            atomsAllocationFull(thread, A);
+        }
+        if (cacheUsed()) {
+            cache->storeAllocation(firstFrame, thread.sphereAtoms);
+        }
     }
 };
 
+// message for an invalid config.sphereRadius or config.sphereRadii, empty if both are valid
+inline std::string sphereRadiiError(const Config &config) {
+    std::vector<double> radii;
+    if (RMSDCalculation::parseRadii(config.sphereRadii, config.sphereRadius, radii)) {
+        return "";
+    }
+    std::ostringstream message;
+    message << "Invalid sphere radii: sphereRadius " << config.sphereRadius << ", sphereRadii \"" << config.sphereRadii
+            << "\" (positive numbers, at most " << MAX_RADII << " radii together with sphereRadius)";
+    return message.str();
+}
+
 #endif // RMSD_CALCULATION_H
@@ -0,0 +1,274 @@
+#ifndef ATOM_SELECTION_H
+#define ATOM_SELECTION_H
+
+#include <cctype>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Atoms kept when a trajectory is read, e.g. "backbone", "heavy and chain A", "resid 10-50 and not name CB".
+//   expression := term ("or" term)*
+//   term       := factor ("and" factor)*
+//   factor     := "not" factor | "(" expression ")" | all | backbone | heavy | hydrogen
+//               | name NAME... | resname NAME... | resid FROM[-TO]... | chain ID...
+// Unselected atoms are never stored, atoms keep their file order in the coordinate store.
+class AtomSelection {
+  private:
+    enum Type { ALL, BACKBONE, HYDROGEN, NAME, RESNAME, RESID, CHAIN, NOT, AND, OR };
+
+    struct Node {
+        Type type;
+        std::vector<std::string> values;
+        std::vector<std::pair<int, int>> ranges;
+        int left;
+        int right;
+    };
+
+    // fields of an ATOM line used by selections
+    struct Atom {
+        std::string name;
+        std::string resName;
+        std::string chain;
+        int resSeq;
+        bool hydrogen;
+    };
+
+    std::vector<Node> nodes;
+    int root;
+    std::vector<std::string> tokens;
+    size_t position;
+    // slot in the store of every atom serial of the first frame, -1 if not selected
+    std::vector<int> slots;
+    int selectedCount;
+    int seenCount;
+
+    static std::string field(const std::string &line, size_t from, size_t length) {
+        if (line.size() <= from) {
+            return "";
+        }
+        std::string value = line.substr(from, length);
+        size_t first = value.find_first_not_of(' ');
+        if (first == std::string::npos) {
+            return "";
+        }
+        return value.substr(first, value.find_last_not_of(' ') - first + 1);
+    }
+
+    static Atom parseAtom(const std::string &line) {
+        Atom atom;
+        atom.name = field(line, 12, 4);
+        atom.resName = field(line, 17, 3);
+        atom.chain = field(line, 21, 1);
+        std::string resSeq = field(line, 22, 4);
+        atom.resSeq = resSeq.empty() ? 0 : std::stoi(resSeq);
+        // element column if present, otherwise the first letter of the name after digits ("1HB" is hydrogen)
+        std::string element = field(line, 76, 2);
+        if (element.empty()) {
+            size_t letter = atom.name.find_first_not_of("0123456789");
+            element = letter == std::string::npos ? "" : atom.name.substr(letter, 1);
+        }
+        atom.hydrogen = element == "H" || element == "D";
+        return atom;
+    }
+
+    bool matches(int node, const Atom &atom) const {
+        const Node &n = nodes[node];
+        switch (n.type) {
+        case ALL:
+            return true;
+        case BACKBONE:
+            return atom.name == "N" || atom.name == "CA" || atom.name == "C" || atom.name == "O";
+        case HYDROGEN:
+            return atom.hydrogen;
+        case NAME:
+        case RESNAME:
+        case CHAIN:
+            for (const std::string &value : n.values) {
+                if (value == (n.type == NAME ? atom.name : (n.type == RESNAME ? atom.resName : atom.chain))) {
+                    return true;
+                }
+            }
+            return false;
+        case RESID:
+            for (const std::pair<int, int> &range : n.ranges) {
+                if (atom.resSeq >= range.first && atom.resSeq <= range.second) {
+                    return true;
+                }
+            }
+            return false;
+        case NOT:
+            return !matches(n.left, atom);
+        case AND:
+            return matches(n.left, atom) && matches(n.right, atom);
+        case OR:
+            return matches(n.left, atom) || matches(n.right, atom);
+        }
+        return false;
+    }
+
+    static bool isKeyword(const std::string &token) {
+        static const char *keywords[] = {"and", "or", "not", "(", ")", "all", "backbone", "heavy", "hydrogen",
+                                         "name", "resname", "resid", "chain"};
+        for (const char *keyword : keywords) {
+            if (token == keyword) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    int add(Type type, int left = -1, int right = -1) {
+        nodes.push_back({type, {}, {}, left, right});
+        return nodes.size() - 1;
+    }
+
+    int parseExpression(std::string &error) {
+        int left = parseTerm(error);
+        while (left >= 0 && position < tokens.size() && tokens[position] == "or") {
+            position++;
+            int right = parseTerm(error);
+            if (right < 0) {
+                return -1;
+            }
+            left = add(OR, left, right);
+        }
+        return left;
+    }
+
+    int parseTerm(std::string &error) {
+        int left = parseFactor(error);
+        while (left >= 0 && position < tokens.size() && tokens[position] == "and") {
+            position++;
+            int right = parseFactor(error);
+            if (right < 0) {
+                return -1;
+            }
+            left = add(AND, left, right);
+        }
+        return left;
+    }
+
+    int parseFactor(std::string &error) {
+        if (position >= tokens.size()) {
+            error = "unexpected end of selection";
+            return -1;
+        }
+        std::string token = tokens[position++];
+        if (token == "not") {
+            int operand = parseFactor(error);
+            return operand < 0 ? -1 : add(NOT, operand);
+        } else if (token == "(") {
+            int inner = parseExpression(error);
+            if (inner < 0) {
+                return -1;
+            }
+            if (position >= tokens.size() || tokens[position] != ")") {
+                error = "missing )";
+                return -1;
+            }
+            position++;
+            return inner;
+        } else if (token == "all") {
+            return add(ALL);
+        } else if (token == "backbone") {
+            return add(BACKBONE);
+        } else if (token == "hydrogen") {
+            return add(HYDROGEN);
+        } else if (token == "heavy") {
+            return add(NOT, add(HYDROGEN));
+        } else if (token == "name" || token == "resname" || token == "resid" || token == "chain") {
+            int node = add(token == "name" ? NAME : (token == "resname" ? RESNAME : (token == "resid" ? RESID : CHAIN)));
+            while (position < tokens.size() && !isKeyword(tokens[position])) {
+                const std::string &value = tokens[position++];
+                if (token != "resid") {
+                    nodes[node].values.push_back(value);
+                    continue;
+                }
+                // "10-50" or "7", negative residue numbers are not supported
+                size_t dash = value.find('-');
+                try {
+                    int from = std::stoi(value.substr(0, dash));
+                    int to = dash == std::string::npos ? from : std::stoi(value.substr(dash + 1));
+                    nodes[node].ranges.push_back({from, to});
+                } catch (const std::exception &) {
+                    error = "invalid residue range: " + value;
+                    return -1;
+                }
+            }
+            if (nodes[node].values.empty() && nodes[node].ranges.empty()) {
+                error = token + " needs at least one value";
+                return -1;
+            }
+            return node;
+        }
+        error = "unexpected token: " + token;
+        return -1;
+    }
+
+  public:
+    AtomSelection() : root(-1), position(0), selectedCount(0), seenCount(0) {}
+
+    // returns false and sets error if expression is invalid
+    bool parse(const std::string &expression, std::string &error) {
+        nodes.clear();
+        tokens.clear();
+        slots.clear();
+        selectedCount = 0;
+        seenCount = 0;
+        position = 0;
+        std::string token;
+        for (char c : expression + " ") {
+            if (std::isspace((unsigned char)c) || c == '(' || c == ')') {
+                if (!token.empty()) {
+                    tokens.push_back(token);
+                    token.clear();
+                }
+                if (c == '(' || c == ')') {
+                    tokens.push_back(std::string(1, c));
+                }
+            } else {
+                token += c;
+            }
+        }
+        if (tokens.empty()) {
+            tokens.push_back("all");
+        }
+        root = parseExpression(error);
+        if (root >= 0 && position < tokens.size()) {
+            error = "unexpected token: " + tokens[position];
+            root = -1;
+        }
+        return root >= 0;
+    }
+
+    // called for ATOM lines of the first frame in file order; returns slot of the atom, -1 if not selected
+    int select(const std::string &line) {
+        int serial = std::stoi(line.substr(6, 5)) - 1;
+        if (serial < 0) {
+            return -1;
+        }
+        if ((int)slots.size() <= serial) {
+            slots.resize(serial + 1, -1);
+        }
+        seenCount++;
+        if (matches(root, parseAtom(line))) {
+            slots[serial] = selectedCount++;
+        }
+        return slots[serial];
+    }
+
+    // slot of atom serial (from 0) of any frame, -1 if not selected
+    inline int slot(int serial) const {
+        return serial >= 0 && serial < (int)slots.size() ? slots[serial] : -1;
+    }
+
+    // selected atoms and all atoms seen by select()
+    int selected() const {
+        return selectedCount;
+    }
+    int total() const {
+        return seenCount;
+    }
+};
+
+#endif // ATOM_SELECTION_H
@@ -0,0 +1,184 @@
+#ifndef AUTOTUNER_H
+#define AUTOTUNER_H
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+#include "file_manager.h"
+#include "globals.h"
+#include "local_search.h"
+#include "local_search_api.h"
+
+// Choosing jumpFromLocalAreaChance, randomFrameWhileSwappingChance and memorySize for the loaded trajectory
+// and config.timeLimitMinutes by successive halving. Every candidate runs short trials with autotuneSeeds
+// seeds, the best third goes on to trials three times longer, until the last round runs at the full time limit.
+// All candidates of a round use the same seeds. Trials run one after another, each on the thread count the
+// tuned config is written for, since the best parameters change with the number of threads sharing the search.
+// The winner maximises the mean best RMSD over seeds and is written as a config file.
+class Autotuner {
+  public:
+    struct Candidate {
+        double jumpChance;
+        double randomFrameChance;
+        double memorySize;
+        // mean best value and mean time to best of the last round the candidate ran in
+        double meanBest;
+        double meanTimeToBest;
+        int rounds;
+    };
+
+  private:
+    static const int SURVIVING_FRACTION = 3;
+
+    Config base;
+    SearchContext &context;
+    int threads;
+    std::vector<Candidate> candidates;
+
+    // 3 x 3 x 3 grid around the defaults, and the values of the base config
+    void buildCandidates() {
+        const double jumpChances[] = {0.02, 0.1, 0.3};
+        const double randomFrameChances[] = {0.002, 0.01, 0.05};
+        const double memorySizes[] = {0, 0.1, 0.4};
+        for (double jump : jumpChances) {
+            for (double randomFrame : randomFrameChances) {
+                for (double memory : memorySizes) {
+                    candidates.push_back({jump, randomFrame, memory, 0, 0, 0});
+                }
+            }
+        }
+        Candidate own = {base.jumpFromLocalAreaChance, base.randomFrameWhileSwappingChance, base.memorySize, 0, 0, 0};
+        bool inGrid = false;
+        for (const Candidate &c : candidates) {
+            inGrid = inGrid || (c.jumpChance == own.jumpChance && c.randomFrameChance == own.randomFrameChance && c.memorySize == own.memorySize);
+        }
+        if (!inGrid) {
+            candidates.push_back(own);
+        }
+    }
+
+    Config trialConfig(const Candidate &candidate, double minutes) {
+        Config trial = base;
+        trial.jumpFromLocalAreaChance = candidate.jumpChance;
+        trial.randomFrameWhileSwappingChance = candidate.randomFrameChance;
+        trial.memorySize = candidate.memorySize;
+        trial.timeLimitMinutes = minutes;
+        trial.ompThreads = threads;
+        trial.showDebugCurrentBest = false;
+        trial.showDebugRouteBest = false;
+        trial.showLogs = false;
+        // values cached by one trial would make later trials look better
+        trial.residentCache = false;
+        return trial;
+    }
+
+    // every (candidate, seed) trial of one round, scores are means over seeds
+    void runRound(double minutes, const std::vector<unsigned> &seeds) {
+        std::shared_ptr<const Trajectory> trajectory = context.trajectory();
+        int trials = candidates.size() * seeds.size();
+        std::vector<double> best(trials, 0), timeToBest(trials, 0);
+
+        for (int t = 0; t < trials; t++) {
+            Config trial = trialConfig(candidates[t / seeds.size()], minutes);
+            LocalSearch localSearch(*trajectory, trial, context.fingerprintIndex(trial));
+            localSearch.seed = seeds[t % seeds.size()];
+            // trials are quiet, only round lines are shown
+            SearchStats stats = localSearch.search();
+            best[t] = stats.best.rmsdValue;
+            timeToBest[t] = stats.timeToBest;
+        }
+
+        for (size_t c = 0; c < candidates.size(); c++) {
+            double bestSum = 0, timeSum = 0;
+            for (size_t s = 0; s < seeds.size(); s++) {
+                bestSum += best[c * seeds.size() + s];
+                timeSum += timeToBest[c * seeds.size() + s];
+            }
+            candidates[c].meanBest = bestSum / seeds.size();
+            candidates[c].meanTimeToBest = timeSum / seeds.size();
+            candidates[c].rounds++;
+        }
+        // higher mean best first, on a tie the one finding it sooner
+        std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) {
+            return a.meanBest > b.meanBest || (a.meanBest == b.meanBest && a.meanTimeToBest < b.meanTimeToBest);
+        });
+    }
+
+  public:
+    Autotuner(const Config &config, SearchContext &context) : base(config), context(context), threads(1) {
+        // the same thread count as LocalSearch::threadsToRun() of a search with this config
+        if (config.ompThreads > 0) {
+            threads = config.ompThreads;
+        } else {
+            threads = std::max(1, (int)(omp_get_num_procs() * config.ompThreadsPerCore));
+        }
+        buildCandidates();
+    }
+
+    // threads every trial runs with, written to the tuned config
+    int trialThreads() const {
+        return threads;
+    }
+
+    // candidates ordered from the best one, after the last round
+    std::vector<Candidate> tune() {
+        int rounds = 0;
+        for (int left = candidates.size(); left > 1; left = (left + SURVIVING_FRACTION - 1) / SURVIVING_FRACTION) {
+            rounds++;
+        }
+        double fullMinutes = base.timeLimitMinutes;
+        std::vector<unsigned> seeds;
+        for (int r = 0; r < rounds; r++) {
+            double minutes = fullMinutes / std::pow(SURVIVING_FRACTION, rounds - 1 - r);
+            // fresh seeds every round, shared by all candidates of the round
+            seeds.clear();
+            for (int s = 0; s < std::max(base.autotuneSeeds, 1); s++) {
+                seeds.push_back(rand());
+            }
+            if (DEBUG) {
+                std::cout << "[Autotune] [Round]: " << r + 1 << " of " << rounds << " [Candidates]: " << candidates.size()
+                          << " [Trial seconds]: " << minutes * 60 << std::endl;
+            }
+            runRound(minutes, seeds);
+            if (r < rounds - 1) {
+                candidates.resize((candidates.size() + SURVIVING_FRACTION - 1) / SURVIVING_FRACTION);
+            }
+        }
+        return candidates;
+    }
+
+    // config file with the tuned values, readable with -c or as a base config of a batch file
+    static bool writeTunedConfig(const Config &config, const Trajectory &trajectory, const std::vector<Candidate> &ranked, int threads) {
+        std::ofstream file(config.autotuneFilename);
+        if (!file.is_open() || ranked.empty()) {
+            if (DEBUG) {
+                std::cout << "Cannot write tuned config: " << config.autotuneFilename << std::endl;
+            }
+            return false;
+        }
+        const Candidate &best = ranked[0];
+        file << "# tuned by --autotune on " << trajectory.frames << " frames, " << trajectory.atoms << " atoms, "
+             << config.timeLimitMinutes << " minutes, " << threads << " threads" << std::endl;
+        file << "# tuned values hold for this thread count, other thread counts should be tuned again" << std::endl;
+        file << "# mean best RMSD " << best.meanBest << " over " << config.autotuneSeeds << " seeds, mean time to best "
+             << best.meanTimeToBest << "s" << std::endl;
+        // every key of the tuned config, so loading the file repeats the tuned runs, but searches instead of tuning
+        Config tuned = config;
+        tuned.ompThreads = threads;
+        tuned.jumpFromLocalAreaChance = best.jumpChance;
+        tuned.randomFrameWhileSwappingChance = best.randomFrameChance;
+        tuned.memorySize = best.memorySize;
+        tuned.autotune = false;
+        tuned.convergenceBenchmark = false;
+        FileManager::writeConfig(tuned, file);
+        return true;
+    }
+};
+
+#endif // AUTOTUNER_H
@@ -0,0 +1,167 @@
+#ifndef COARSE_SCREENING_H
+#define COARSE_SCREENING_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <eigen3/Eigen/Dense>
+
+#include "globals.h"
+#include "trajectory.h"
+
+// Cheap first level of pair evaluation.
+// Coarse score of a pair is the sum of CA-only RMSDs over a few representative spheres,
+// calculated from compact float copy of CA coordinates, so it stays in cache.
+// Coarse score is scaled to the full score by a ratio calibrated on every fully evaluated pair,
+// and a pair is fully evaluated only if its scaled coarse score is within margin of the value to beat.
+class CoarseScreening {
+  private:
+    struct ThreadState {
+        int allocatedOnFrame;
+        // CA indices (sphere numbers) inside every representative sphere
+        std::vector<std::vector<int>> members;
+        double ratio;
+        int calibrated;
+    };
+
+    const Trajectory &trajectory;
+    // CA coordinates [<frame>][<sphere>][<coordinate>]
+    std::vector<float> CA;
+    std::vector<int> representatives;
+    std::vector<ThreadState> threads;
+    double margin;
+    double sphereRadius;
+
+    // pairs fully evaluated on a thread before screening starts
+    static const int CALIBRATION_PAIRS = 8;
+
+    inline const float *coordinates(int frame, int sphere) {
+        return &CA[((size_t)frame * trajectory.spheres + sphere) * 3];
+    }
+
+    void allocate(ThreadState &state, int frame) {
+        state.allocatedOnFrame = frame;
+        double radius2 = sphereRadius * sphereRadius;
+        for (size_t r = 0; r < representatives.size(); r++) {
+            state.members[r].clear();
+            const float *center = coordinates(frame, representatives[r]);
+            for (int s = 0; s < trajectory.spheres; s++) {
+                const float *p = coordinates(frame, s);
+                double dx = p[0] - center[0];
+                double dy = p[1] - center[1];
+                double dz = p[2] - center[2];
+                if (dx*dx + dy*dy + dz*dz <= radius2) {
+                    state.members[r].push_back(s);
+                }
+            }
+        }
+    }
+
+    // RMSD after optimal rotation (Kabsch) of CA atoms of one sphere
+    double sphereRMSD(const std::vector<int> &members, int frame1, int frame2) {
+        int n = members.size();
+        if (n < 3) {
+            return 0;
+        }
+        Eigen::Vector3d c1 = Eigen::Vector3d::Zero();
+        Eigen::Vector3d c2 = Eigen::Vector3d::Zero();
+        for (int m : members) {
+            const float *p1 = coordinates(frame1, m);
+            const float *p2 = coordinates(frame2, m);
+            c1 += Eigen::Vector3d(p1[0], p1[1], p1[2]);
+            c2 += Eigen::Vector3d(p2[0], p2[1], p2[2]);
+        }
+        c1 /= n;
+        c2 /= n;
+        Eigen::Matrix3d H = Eigen::Matrix3d::Zero();
+        double squares = 0;
+        for (int m : members) {
+            const float *p1 = coordinates(frame1, m);
+            const float *p2 = coordinates(frame2, m);
+            Eigen::Vector3d a = Eigen::Vector3d(p1[0], p1[1], p1[2]) - c1;
+            Eigen::Vector3d b = Eigen::Vector3d(p2[0], p2[1], p2[2]) - c2;
+            H += b * a.transpose();
+            squares += a.squaredNorm() + b.squaredNorm();
+        }
+        // sum of squared distances after optimal rotation is squares - 2 * trace(R * H)
+        Eigen::JacobiSVD<Eigen::Matrix3d> svd(H, Eigen::ComputeFullU | Eigen::ComputeFullV);
+        Eigen::Vector3d sv = svd.singularValues();
+        double d = (svd.matrixU() * svd.matrixV().transpose()).determinant() > 0 ? 1.0 : -1.0;
+        double traceRH = sv(0) + sv(1) + d * sv(2);
+        double result = std::max(squares - 2 * traceRH, 0.0) / n;
+        return sqrt(result);
+    }
+
+  public:
+    bool enabled;
+
+    CoarseScreening(const Trajectory &trajectory) : trajectory(trajectory), margin(0), sphereRadius(8), enabled(false) {}
+
+    // copying CA coordinates of all frames, choosing evenly spread representative spheres of CA atoms within radius
+    void build(int representativeCount, double screeningMargin, double radius) {
+        enabled = true;
+        margin = screeningMargin;
+        sphereRadius = radius;
+        int spheres = trajectory.spheres;
+        CA.resize((size_t)trajectory.frames * spheres * 3);
+        for (int f = 0; f < trajectory.frames; f++) {
+            for (int s = 0; s < spheres; s++) {
+                for (int k = 0; k < 3; k++) {
+                    CA[((size_t)f * spheres + s) * 3 + k] = trajectory.A.at(f, trajectory.sphereCA[s], k);
+                }
+            }
+        }
+        int count = representativeCount <= 0 ? spheres : std::min(representativeCount, spheres);
+        representatives.clear();
+        for (int r = 0; r < count; r++) {
+            representatives.push_back((long long)r * spheres / count);
+        }
+    }
+
+    void initThreads(int threadsCount) {
+        threads.assign(threadsCount, {-1, std::vector<std::vector<int>>(representatives.size()), 1.0, 0});
+    }
+
+    // coarse score of pair, spheres allocated on frame1
+    double score(int frame1, int frame2) {
+        ThreadState &state = threads[omp_thread_id];
+        if (state.allocatedOnFrame != frame1) {
+            allocate(state, frame1);
+        }
+        double result = 0;
+        for (size_t r = 0; r < representatives.size(); r++) {
+            result += sphereRMSD(state.members[r], frame1, frame2);
+        }
+        return result;
+    }
+
+    // false if pair has no chance to get within margin of threshold
+    inline bool worthEvaluating(double coarseScore, double threshold) {
+        ThreadState &state = threads[omp_thread_id];
+        if (threshold <= 0 || state.calibrated < CALIBRATION_PAIRS) {
+            return true;
+        }
+        return coarseScore * state.ratio >= threshold * (1 - margin);
+    }
+
+    // updating full to coarse score ratio, running mean during calibration, then moving average
+    inline void calibrate(double coarseScore, double fullScore) {
+        if (coarseScore <= 0) {
+            return;
+        }
+        ThreadState &state = threads[omp_thread_id];
+        double ratio = fullScore / coarseScore;
+        if (state.calibrated < CALIBRATION_PAIRS) {
+            state.ratio = (state.ratio * state.calibrated + ratio) / (state.calibrated + 1);
+        } else {
+            state.ratio = state.ratio * 0.95 + ratio * 0.05;
+        }
+        state.calibrated++;
+    }
+
+    size_t memoryBytes() {
+        return CA.size() * sizeof(float);
+    }
+};
+
+#endif // COARSE_SCREENING_H
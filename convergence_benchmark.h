@@ -0,0 +1,269 @@
+#ifndef CONVERGENCE_BENCHMARK_H
+#define CONVERGENCE_BENCHMARK_H
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "file_manager.h"
+#include "globals.h"
+#include "local_search.h"
+#include "local_search_api.h"
+
+// Anytime performance of one configuration: the same search is run with convergenceSeeds seeds for every
+// thread count of convergenceThreads, and the incumbent trace of every run is kept. Runs are compared with
+// a reference value, the optimum if it is known (convergenceOptimum) or else the best value of all runs:
+//  - time to target: first time the incumbent reached convergenceTarget * reference, -1 if it never did,
+//  - AUC: area under the incumbent curve over the time limit, divided by the time limit (mean incumbent),
+//  - gap: (reference - best) / reference at the end, and its integral over the time limit divided by
+//    the time limit (1 before the first incumbent), which is 0 only if the reference is found at once.
+class ConvergenceBenchmark {
+  public:
+    struct Run {
+        int threads;
+        unsigned seed;
+        double best;
+        double timeToBest;
+        double elapsedSeconds;
+        long rmsdCalculations;
+        std::vector<IncumbentPoint> trace;
+        // filled by evaluate()
+        double timeToTarget;
+        double auc;
+        double gap;
+        double gapIntegral;
+    };
+
+    struct Summary {
+        int threads;
+        int runs;
+        double meanBest;
+        double worstBest;
+        // runs which reached the target, and median of their times to target
+        int reached;
+        double medianTimeToTarget;
+        double meanAuc;
+        double meanGap;
+        double meanGapIntegral;
+    };
+
+  private:
+    Config base;
+    SearchContext &context;
+    std::vector<int> threadCounts;
+    std::vector<unsigned> seeds;
+    std::vector<Run> runs;
+    double reference;
+    bool optimumKnown;
+    double target;
+
+    // "1,2,4" to {1, 2, 4}, 0 meaning all cpu cores
+    static std::vector<int> parseThreads(const std::string &list) {
+        std::vector<int> result;
+        std::stringstream stream(list);
+        std::string item;
+        while (std::getline(stream, item, ',')) {
+            if (item.empty()) {
+                continue;
+            }
+            int count = std::stoi(item);
+            result.push_back(count > 0 ? count : omp_get_num_procs());
+        }
+        if (result.empty()) {
+            result.push_back(1);
+        }
+        return result;
+    }
+
+    static double median(std::vector<double> values) {
+        if (values.empty()) {
+            return -1;
+        }
+        std::sort(values.begin(), values.end());
+        size_t middle = values.size() / 2;
+        return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+    }
+
+    Run runOnce(int threads, unsigned seed) {
+        Config runConfig = base;
+        runConfig.ompThreads = threads;
+        runConfig.showDebugCurrentBest = false;
+        runConfig.showDebugRouteBest = false;
+        runConfig.showLogs = false;
+        runConfig.writeAsCSV = false;
+        runConfig.writeAsJSON = false;
+        runConfig.sphereMap = false;
+        // values cached by one run would make later runs converge faster
+        runConfig.residentCache = false;
+        LocalSearch localSearch(*context.trajectory(), runConfig, context.fingerprintIndex(runConfig));
+        localSearch.seed = seed;
+        SearchStats stats = localSearch.search();
+        return {threads, seed, stats.best.rmsdValue, stats.timeToBest, stats.elapsedSeconds, stats.rmsdCalculations, stats.trace, -1, 0, 0, 0};
+    }
+
+    // statistics of one run against the reference, over [0, limit]
+    void evaluate(Run &run, double limit) const {
+        run.timeToTarget = -1;
+        run.auc = 0;
+        run.gapIntegral = 0;
+        double previousTime = 0, previousValue = -1;
+        for (const IncumbentPoint &point : run.trace) {
+            double time = std::min(point.seconds, limit);
+            run.auc += (time - previousTime) * std::max(previousValue, 0.0);
+            run.gapIntegral += (time - previousTime) * gapOf(previousValue);
+            previousTime = time;
+            previousValue = point.rmsdValue;
+            if (run.timeToTarget < 0 && point.rmsdValue >= target) {
+                run.timeToTarget = point.seconds;
+            }
+        }
+        run.auc += (limit - previousTime) * std::max(previousValue, 0.0);
+        run.gapIntegral += (limit - previousTime) * gapOf(previousValue);
+        run.auc /= limit;
+        run.gapIntegral /= limit;
+        run.gap = gapOf(run.best);
+    }
+
+    // relative gap of an incumbent to the reference, 1 with no incumbent yet
+    double gapOf(double value) const {
+        if (value < 0 || reference <= 0) {
+            return 1;
+        }
+        return std::max(reference - value, 0.0) / reference;
+    }
+
+  public:
+    ConvergenceBenchmark(const Config &config, SearchContext &context)
+        : base(config), context(context), reference(0), optimumKnown(false), target(0) {
+        threadCounts = parseThreads(config.convergenceThreads);
+        // the same seeds for every thread count
+        for (int s = 0; s < std::max(config.convergenceSeeds, 1); s++) {
+            seeds.push_back(rand());
+        }
+    }
+
+    std::vector<Run> run() {
+        runs.clear();
+        for (int threads : threadCounts) {
+            for (unsigned seed : seeds) {
+                // runs are quiet, only progress lines are shown
+                Run result = runOnce(threads, seed);
+                if (DEBUG) {
+                    std::cout << "[Convergence] [Threads]: " << threads << " [Seed]: " << seed << " [Best]: " << result.best
+                              << " [Time to best]: " << result.timeToBest << "s" << std::endl;
+                }
+                runs.push_back(result);
+            }
+        }
+
+        optimumKnown = base.convergenceOptimum > 0;
+        reference = base.convergenceOptimum;
+        if (!optimumKnown) {
+            for (const Run &r : runs) {
+                reference = std::max(reference, r.best);
+            }
+        }
+        target = base.convergenceTarget * reference;
+        double limit = base.timeLimitMinutes * 60;
+        for (Run &r : runs) {
+            evaluate(r, limit);
+        }
+        return runs;
+    }
+
+    // one summary per thread count, in the order of convergenceThreads
+    std::vector<Summary> summaries() const {
+        std::vector<Summary> result;
+        for (int threads : threadCounts) {
+            Summary s = {threads, 0, 0, -1, 0, -1, 0, 0, 0};
+            std::vector<double> timesToTarget;
+            for (const Run &r : runs) {
+                if (r.threads != threads) {
+                    continue;
+                }
+                s.runs++;
+                s.meanBest += r.best;
+                s.worstBest = s.worstBest < 0 ? r.best : std::min(s.worstBest, r.best);
+                s.meanAuc += r.auc;
+                s.meanGap += r.gap;
+                s.meanGapIntegral += r.gapIntegral;
+                if (r.timeToTarget >= 0) {
+                    timesToTarget.push_back(r.timeToTarget);
+                }
+            }
+            if (s.runs > 0) {
+                s.meanBest /= s.runs;
+                s.meanAuc /= s.runs;
+                s.meanGap /= s.runs;
+                s.meanGapIntegral /= s.runs;
+            }
+            s.reached = timesToTarget.size();
+            s.medianTimeToTarget = median(timesToTarget);
+            result.push_back(s);
+        }
+        return result;
+    }
+
+    void print() const {
+        ::print("Convergence Results:");
+        ::print(" - Reference: ", reference, optimumKnown ? " (optimum given)" : " (best of all runs)", ", target: ", target);
+        for (const Summary &s : summaries()) {
+            ::print(" - Threads: ", s.threads, ", runs: ", s.runs, ", mean best: ", s.meanBest, ", worst best: ", s.worstBest,
+                    ", reached target: ", s.reached, " (median time ", s.medianTimeToTarget, "s), mean AUC: ", s.meanAuc,
+                    ", mean gap: ", s.meanGap, ", mean gap integral: ", s.meanGapIntegral);
+        }
+    }
+
+    // one JSON document with settings, per thread count summaries and every run with its trace as [seconds, rmsd] pairs
+    bool write() const {
+        std::ofstream file(base.convergenceFilename);
+        if (!file.is_open()) {
+            if (DEBUG) {
+                std::cout << "Cannot write convergence results: " << base.convergenceFilename << std::endl;
+            }
+            return false;
+        }
+        file << "{\"trajectory\": " << FileManager::jsonString(base.trajectoryFilename) << ", "
+             << "\"atomSelection\": " << FileManager::jsonString(context.trajectory()->selection) << ", "
+             << "\"frames\": " << context.trajectory()->frames << ", "
+             << "\"timeLimitMinutes\": " << base.timeLimitMinutes << ", "
+             << "\"searchStrategy\": " << FileManager::jsonString(base.searchStrategy) << ", "
+             << "\"jumpFromLocalAreaChance\": " << base.jumpFromLocalAreaChance << ", "
+             << "\"randomFrameWhileSwappingChance\": " << base.randomFrameWhileSwappingChance << ", "
+             << "\"memorySize\": " << base.memorySize << ", "
+             << "\"reference\": " << reference << ", "
+             << "\"optimumKnown\": " << (optimumKnown ? "true" : "false") << ", "
+             << "\"target\": " << target << "," << std::endl;
+        file << " \"summary\": [";
+        std::vector<Summary> all = summaries();
+        for (size_t k = 0; k < all.size(); k++) {
+            const Summary &s = all[k];
+            file << (k ? "," : "") << std::endl
+                 << "  {\"threads\": " << s.threads << ", \"runs\": " << s.runs << ", \"meanBest\": " << s.meanBest
+                 << ", \"worstBest\": " << s.worstBest << ", \"reached\": " << s.reached
+                 << ", \"medianTimeToTarget\": " << s.medianTimeToTarget << ", \"meanAuc\": " << s.meanAuc
+                 << ", \"meanGap\": " << s.meanGap << ", \"meanGapIntegral\": " << s.meanGapIntegral << "}";
+        }
+        file << "]," << std::endl << " \"runs\": [";
+        for (size_t k = 0; k < runs.size(); k++) {
+            const Run &r = runs[k];
+            file << (k ? "," : "") << std::endl
+                 << "  {\"threads\": " << r.threads << ", \"seed\": " << r.seed << ", \"best\": " << r.best
+                 << ", \"timeToBest\": " << r.timeToBest << ", \"elapsedTime\": " << r.elapsedSeconds
+                 << ", \"rmsdCalculations\": " << r.rmsdCalculations << ", \"timeToTarget\": " << r.timeToTarget
+                 << ", \"auc\": " << r.auc << ", \"gap\": " << r.gap << ", \"gapIntegral\": " << r.gapIntegral << ", \"trace\": [";
+            for (size_t p = 0; p < r.trace.size(); p++) {
+                file << (p ? ", " : "") << "[" << r.trace[p].seconds << ", " << r.trace[p].rmsdValue << "]";
+            }
+            file << "]}";
+        }
+        file << "]}" << std::endl;
+        return true;
+    }
+};
+
+#endif // CONVERGENCE_BENCHMARK_H
@@ -0,0 +1,280 @@
+#ifndef COORDINATE_STORE_H
+#define COORDINATE_STORE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+#include <sys/mman.h>
+
+#include "globals.h"
+#include "numa_placement.h"
+
+// NUMA node of the thread, selects the copy of coordinates to read
+extern int omp_numa_node;
+#pragma omp threadprivate(omp_numa_node)
+
+// Atom coordinates of all frames in one flat region, accessed as A[<frame>][<atom>][<coordinate>].
+// Region is placed with given NUMA policy and may be backed by huge pages. With "replicate"
+// placement every node gets its own copy, and threads read the copy of the node they run on.
+// Quantised stores keep int16 fixed point coordinates relative to a per-frame origin (the center
+// of the frame's bounding box) with a per-frame step, a quarter of the doubles; they are read
+// with at() or quantisedFrame(), A[<frame>] is only valid for double stores.
+class CoordinateStore {
+  public:
+    struct FrameView {
+        double *base;
+        inline double *operator[](int atom) const {
+            return base + (size_t)atom * 3;
+        }
+        inline double coordinate(int atom, int k) const {
+            return base[(size_t)atom * 3 + k];
+        }
+    };
+
+    // coordinate = origin + code * step, so every coordinate is within step / 2 of the original
+    struct QuantisedFrameView {
+        const int16_t *codes;
+        const double *origin;
+        double step;
+        inline double coordinate(int atom, int k) const {
+            return origin[k] + codes[(size_t)atom * 3 + k] * step;
+        }
+    };
+
+  private:
+    static const int CODE_RANGE = 32767;
+
+    int frames;
+    int atoms;
+    // coordinates of one copy, and the mapped length of every copy (rounded up to huge pages)
+    size_t bytes;
+    std::vector<void *> replicas;
+    std::vector<size_t> mappedBytes;
+    // copy read by threads of every node, the primary one for nodes without their own copy; empty unless replicated
+    std::vector<void *> nodeCopies;
+    // borrowed regions belong to the caller and are never unmapped
+    bool borrowed;
+    bool quantisedCodes;
+    // origin (3 values) and step of every frame of a quantised store
+    std::vector<double> origins;
+    std::vector<double> steps;
+
+    inline void *copy() const {
+        return (size_t)omp_numa_node < nodeCopies.size() ? nodeCopies[omp_numa_node] : replicas[0];
+    }
+
+    inline double *data() const {
+        return (double *)copy();
+    }
+
+    inline int16_t *codes() const {
+        return (int16_t *)copy();
+    }
+
+    size_t valueBytes() const {
+        return quantisedCodes ? sizeof(int16_t) : sizeof(double);
+    }
+
+  public:
+    std::string placement;
+    std::string hugePages;
+
+    CoordinateStore() : frames(0), atoms(0), bytes(0), borrowed(false), quantisedCodes(false), placement("none"), hugePages("none") {}
+
+    ~CoordinateStore() {
+        release();
+    }
+
+    void release() {
+        for (size_t r = 0; r < replicas.size() && !borrowed; r++) {
+            munmap(replicas[r], mappedBytes[r]);
+        }
+        replicas.clear();
+        mappedBytes.clear();
+        nodeCopies.clear();
+        borrowed = false;
+        quantisedCodes = false;
+        origins.clear();
+        steps.clear();
+        frames = 0;
+        atoms = 0;
+    }
+
+    void swap(CoordinateStore &other) {
+        std::swap(frames, other.frames);
+        std::swap(atoms, other.atoms);
+        std::swap(bytes, other.bytes);
+        replicas.swap(other.replicas);
+        mappedBytes.swap(other.mappedBytes);
+        nodeCopies.swap(other.nodeCopies);
+        std::swap(borrowed, other.borrowed);
+        std::swap(quantisedCodes, other.quantisedCodes);
+        origins.swap(other.origins);
+        steps.swap(other.steps);
+        placement.swap(other.placement);
+        hugePages.swap(other.hugePages);
+    }
+
+    // placement: none, interleave or replicate; requestedHugePages: none, transparent or explicit;
+    // quantised stores are written frame by frame with setFrame()
+    bool allocate(int framesCount, int atomsCount, const std::string &requestedPlacement, const std::string &requestedHugePages,
+                  bool quantised = false) {
+        release();
+        frames = framesCount;
+        atoms = atomsCount;
+        placement = requestedPlacement;
+        quantisedCodes = quantised;
+        bytes = std::max<size_t>((size_t)frames * atoms * 3 * valueBytes(), 1);
+        NumaTopology &topology = numaTopology();
+        int node = placement == "interleave" ? -2 : (placement == "replicate" ? 0 : -1);
+        size_t mapped;
+        void *primary = topology.allocate(bytes, requestedHugePages, node, hugePages, mapped);
+        if (primary == nullptr && node == 0) {
+            // node 0 has no memory, the primary copy goes anywhere
+            primary = topology.allocate(bytes, requestedHugePages, -1, hugePages, mapped);
+        }
+        if (primary == nullptr) {
+            return false;
+        }
+        replicas.push_back(primary);
+        mappedBytes.push_back(mapped);
+        if (quantisedCodes) {
+            origins.assign((size_t)frames * 3, 0.0);
+            steps.assign(frames, 0.0);
+        }
+        return true;
+    }
+
+    // using coordinates owned by the caller, laid out as [<frame>][<atom>][<coordinate>], without copying;
+    // they have to stay valid and unchanged until release()
+    void borrow(double *coordinates, int framesCount, int atomsCount) {
+        release();
+        frames = framesCount;
+        atoms = atomsCount;
+        placement = "none";
+        hugePages = "none";
+        bytes = (size_t)frames * atoms * 3 * sizeof(double);
+        replicas.push_back(coordinates);
+        borrowed = true;
+    }
+
+    // writing frame from atoms * 3 doubles, encoded if the store is quantised
+    void setFrame(int frame, const double *coordinates) {
+        if (!quantisedCodes) {
+            memcpy(data() + (size_t)frame * atoms * 3, coordinates, (size_t)atoms * 3 * sizeof(double));
+            return;
+        }
+        double low[3], high[3];
+        for (int k = 0; k < 3; k++) {
+            low[k] = atoms > 0 ? coordinates[k] : 0;
+            high[k] = low[k];
+        }
+        for (int a = 0; a < atoms; a++) {
+            for (int k = 0; k < 3; k++) {
+                low[k] = std::min(low[k], coordinates[a * 3 + k]);
+                high[k] = std::max(high[k], coordinates[a * 3 + k]);
+            }
+        }
+        double *origin = &origins[(size_t)frame * 3];
+        double halfExtent = 0;
+        for (int k = 0; k < 3; k++) {
+            origin[k] = (low[k] + high[k]) / 2;
+            halfExtent = std::max(halfExtent, (high[k] - low[k]) / 2);
+        }
+        double step = halfExtent > 0 ? halfExtent / CODE_RANGE : 1.0;
+        steps[frame] = step;
+        int16_t *out = codes() + (size_t)frame * atoms * 3;
+        for (int a = 0; a < atoms; a++) {
+            for (int k = 0; k < 3; k++) {
+                long code = std::lround((coordinates[a * 3 + k] - origin[k]) / step);
+                out[a * 3 + k] = (int16_t)std::min<long>(std::max<long>(code, -CODE_RANGE), CODE_RANGE);
+            }
+        }
+    }
+
+    // quantised copy of a double store, with the same placement
+    bool quantiseFrom(const CoordinateStore &source) {
+        if (!allocate(source.frames, source.atoms, source.placement, source.hugePages, true)) {
+            return false;
+        }
+        for (int f = 0; f < frames; f++) {
+            setFrame(f, source[f].base);
+        }
+        return true;
+    }
+
+    // copying primary region to every other node, called once all coordinates are written;
+    // threads of nodes a copy cannot be placed on (e.g. nodes without memory) read the primary one
+    void replicate() {
+        if (placement != "replicate") {
+            return;
+        }
+        NumaTopology &topology = numaTopology();
+        std::string replicaHugePages;
+        nodeCopies.assign(topology.nodes(), replicas[0]);
+        for (int node = 1; node < topology.nodes(); node++) {
+            size_t mapped;
+            void *replica = topology.allocate(bytes, hugePages, node, replicaHugePages, mapped);
+            if (replica == nullptr) {
+                debug("No copy of coordinates on NUMA node ", node, ", its threads read copy 0");
+                continue;
+            }
+            memcpy(replica, replicas[0], (size_t)frames * atoms * 3 * valueBytes());
+            replicas.push_back(replica);
+            mappedBytes.push_back(mapped);
+            nodeCopies[node] = replica;
+        }
+    }
+
+    inline FrameView operator[](int frame) const {
+        return {data() + (size_t)frame * atoms * 3};
+    }
+
+    inline QuantisedFrameView quantisedFrame(int frame) const {
+        return {codes() + (size_t)frame * atoms * 3, &origins[(size_t)frame * 3], steps[frame]};
+    }
+
+    // single coordinate of either kind of store, for code outside the RMSD kernels
+    inline double at(int frame, int atom, int k) const {
+        if (quantisedCodes) {
+            return quantisedFrame(frame).coordinate(atom, k);
+        }
+        return data()[((size_t)frame * atoms + atom) * 3 + k];
+    }
+
+    bool quantised() const {
+        return quantisedCodes;
+    }
+
+    // largest distance of a stored atom of the frame from the original one; each coordinate is within step / 2
+    double maxError(int frame) const {
+        return quantisedCodes ? std::sqrt(3.0) * steps[frame] / 2 : 0;
+    }
+
+    int size() const {
+        return frames;
+    }
+
+    size_t memoryBytes() const {
+        size_t mapped = 0;
+        for (size_t length : mappedBytes) {
+            mapped += length;
+        }
+        return (borrowed ? bytes : mapped) + (origins.size() + steps.size()) * sizeof(double);
+    }
+
+    // pages of every replica per node
+    std::vector<std::vector<int>> pagesPerNode() {
+        std::vector<std::vector<int>> result;
+        for (void *replica : replicas) {
+            result.push_back(numaTopology().pagesPerNode(replica, bytes));
+        }
+        return result;
+    }
+};
+
+#endif // COORDINATE_STORE_H
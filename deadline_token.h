@@ -0,0 +1,132 @@
+#ifndef DEADLINE_TOKEN_H
+#define DEADLINE_TOKEN_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Time limit shared by all threads of one search. Strategies ask expired() on every step, but a thread
+// reads the clock only every few steps: the number of steps between reads is adapted to the measured step time,
+// so the clock is read about once per targetLatency. The first thread seeing the deadline raises the shared flag,
+// which every other thread sees on its next step, so the search stops within max(targetLatency, MAX_INTERVAL steps) of the limit.
+class DeadlineToken {
+  private:
+    // upper bound of steps between clock reads, limits the overshoot when cheap steps (values remembered
+    // in memory) are followed by full RMSD calculations; a clock read costs less than the cheapest step anyway
+    static const int MAX_INTERVAL = 8;
+
+    struct alignas(64) ThreadState {
+        int countdown;
+        int interval;
+        std::chrono::steady_clock::time_point lastCheck;
+    };
+
+    std::chrono::steady_clock::time_point deadline;
+    double targetLatency;
+    std::atomic<bool> stopped;
+    std::vector<ThreadState> threadStates;
+
+  public:
+    DeadlineToken() : targetLatency(0.001), stopped(false) {}
+
+    void init(int threads, std::chrono::steady_clock::time_point start, double limitSeconds, double latencySeconds) {
+        deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(limitSeconds));
+        targetLatency = std::max(latencySeconds, 1e-6);
+        stopped = false;
+        threadStates.assign(threads, {1, 1, start});
+    }
+
+    inline bool expired(int thread) {
+        if (stopped.load(std::memory_order_relaxed)) {
+            return true;
+        }
+        ThreadState &s = threadStates[thread];
+        if (--s.countdown > 0) {
+            return false;
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+            stopped.store(true, std::memory_order_relaxed);
+            return true;
+        }
+        // at most doubling, so a few cheap steps can't postpone the next read for long
+        std::chrono::duration<double> sinceCheck = now - s.lastCheck;
+        double stepSeconds = sinceCheck.count() / s.interval;
+        int fitting = stepSeconds > 0 ? (int)std::min(targetLatency / stepSeconds, (double)MAX_INTERVAL) : MAX_INTERVAL;
+        s.interval = std::max(1, std::min(fitting, s.interval * 2));
+        s.countdown = s.interval;
+        s.lastCheck = now;
+        return false;
+    }
+
+    // seconds since the deadline, negative if it has not passed yet
+    double secondsLate(std::chrono::steady_clock::time_point when) const {
+        std::chrono::duration<double> late = when - deadline;
+        return late.count();
+    }
+};
+
+// Counts of how late threads stopped after the time limit, in logarithmic buckets of milliseconds.
+class StopLatencyHistogram {
+  private:
+    static const int BUCKETS = 7;
+    std::vector<long> counts;
+    double maxSeconds;
+
+    static double bound(int bucket) {
+        static const double bounds[BUCKETS - 1] = {0.1, 0.3, 1, 3, 10, 30};
+        return bounds[bucket];
+    }
+
+  public:
+    StopLatencyHistogram() : counts(BUCKETS, 0), maxSeconds(0) {}
+
+    void add(double seconds) {
+        double ms = seconds * 1000;
+        int bucket = 0;
+        while (bucket < BUCKETS - 1 && ms >= bound(bucket)) {
+            bucket++;
+        }
+        counts[bucket]++;
+        maxSeconds = std::max(maxSeconds, seconds);
+    }
+
+    long total() const {
+        long sum = 0;
+        for (long c : counts) {
+            sum += c;
+        }
+        return sum;
+    }
+
+    double max() const {
+        return maxSeconds;
+    }
+
+    // e.g. "<0.1ms: 3, 0.1-0.3ms: 1", empty buckets are left out
+    std::string buckets() const {
+        std::ostringstream out;
+        bool first = true;
+        for (int b = 0; b < BUCKETS; b++) {
+            if (counts[b] == 0) {
+                continue;
+            }
+            out << (first ? "" : ", ");
+            if (b == 0) {
+                out << "<" << bound(0) << "ms";
+            } else if (b == BUCKETS - 1) {
+                out << ">=" << bound(BUCKETS - 2) << "ms";
+            } else {
+                out << bound(b - 1) << "-" << bound(b) << "ms";
+            }
+            out << ": " << counts[b];
+            first = false;
+        }
+        return out.str();
+    }
+};
+
+#endif // DEADLINE_TOKEN_H
@@ -0,0 +1,266 @@
+#ifndef EVALUATOR_H
+#define EVALUATOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <omp.h>
+
+#include "RMSD_calculation.h"
+#include "deadline_token.h"
+#include "fingerprint_index.h"
+#include "globals.h"
+#include "top_k.h"
+#include "trajectory.h"
+
+struct LocalSearchResult {
+    double rmsdValue;
+    int i;
+    int j;
+    LocalSearchResult() : rmsdValue(-1), i(-1), j(-1) {}
+    LocalSearchResult(double rmsdValue, int i, int j) : rmsdValue(rmsdValue), i(i), j(j) {}
+};
+
+// improvement of the incumbent, seconds from the start of the search
+struct IncumbentPoint {
+    double seconds;
+    double rmsdValue;
+};
+
+// State shared by every search strategy of one search: parameters, RMSD calculation,
+// the incumbent (best result so far) and the top K pairs.
+class Evaluator {
+  public:
+    // own copy of parameters, so searches with different configs can run side by side
+    Config config;
+    const Trajectory &trajectory;
+    LocalSearchResult bestResult;
+    TopKPairs topK;
+    RMSDCalculation rmsd;
+    // read only, may be shared with other searches on the same trajectory
+    std::shared_ptr<const FingerprintIndex> index;
+    std::chrono::time_point<std::chrono::steady_clock, std::chrono::nanoseconds> start;
+    // seconds from start to the last improvement of the incumbent
+    double timeToBest;
+    // seconds from the start of trajectory loading to the first incumbent
+    double timeToFirstResult;
+    // every improvement of the incumbent, in order
+    std::vector<IncumbentPoint> incumbentTrace;
+    // incumbent improvements published during the current route of each thread
+    std::vector<double> routeGain;
+    // set from any thread to stop the search before its time limit
+    std::atomic<bool> cancelled;
+    // time limit from start, initialized by the search before threads start
+    DeadlineToken deadline;
+
+  private:
+    // trajectory was still being read when the search was created, so the matrix grows with it
+    bool growingMatrix;
+    // config.matrixSize while the matrix grows
+    std::atomic<int> liveMatrixSize;
+    // first frame appended by the last growth of the matrix
+    std::atomic<int> newFramesFrom;
+    // value of bestResult, read without the critical section to skip values which cannot improve it
+    std::atomic<double> incumbentValue;
+
+  public:
+
+    // index is built here if the config asks for one and no prebuilt index is given
+    Evaluator(const Trajectory &trajectory, const Config &searchConfig, std::shared_ptr<const FingerprintIndex> prebuiltIndex = nullptr,
+              std::shared_ptr<ResidentCache> residentCache = nullptr)
+        : config(searchConfig), trajectory(trajectory), rmsd(trajectory), index(prebuiltIndex), timeToBest(0), timeToFirstResult(0),
+          cancelled(false), growingMatrix(trajectory.loading), incumbentValue(-1) {
+        int frames = trajectory.available;
+        // analysed range is clamped to the trajectory
+        config.frameFrom = std::min(std::max(config.frameFrom, 0), std::max(frames - 2, 0));
+        if (config.matrixSize == -1 || config.frameFrom + config.matrixSize > frames) {
+            config.matrixSize = frames - config.frameFrom;
+        }
+        if (growingMatrix) {
+            // CA copy and fingerprints exist only for frames read before the search
+            config.coarseScreening = false;
+            config.fingerprintIndex = false;
+            index = nullptr;
+        }
+        liveMatrixSize = config.matrixSize;
+        startMatrixSize = config.matrixSize;
+        newFramesFrom = config.frameFrom + config.matrixSize;
+        std::vector<double> radii;
+        if (!RMSDCalculation::parseRadii(config.sphereRadii, config.sphereRadius, radii)) {
+            // callers validate with sphereRadiiError(), a library search with invalid radii scores sphereRadius only
+            searchLog(sphereRadiiError(config), ", scoring sphereRadius only");
+            radii.assign(1, config.sphereRadius);
+        }
+        rmsd.setRadii(config.sphereRadius, radii);
+        rmsd.cache = residentCache;
+        rmsd.initMemory(config.memorySize, config.matrixSize);
+        rmsd.fixedSizeKernels = config.fixedSizeKernels;
+        rmsd.trackSpheres = config.sphereMap;
+        if (config.coarseScreening) {
+            rmsd.coarse.build(config.coarseSpheres, config.coarseMargin, config.sphereRadius);
+        }
+        if (config.fingerprintIndex && !index) {
+            std::shared_ptr<FingerprintIndex> built = std::make_shared<FingerprintIndex>();
+            built->build(trajectory, config.frameFrom + config.matrixSize, config.fingerprintPairs);
+            index = built;
+        }
+    }
+
+    // preparing per-thread state before threads start searching
+    void initThreads(int threads) {
+        topK.init(config.topK, config.topKMinSeparation, threads);
+        routeGain.assign(threads, 0);
+        rmsd.initThreads(threads, config.verletSkin);
+        if (config.coarseScreening) {
+            rmsd.coarse.initThreads(threads);
+        }
+    }
+
+    // log line of this search, shown with its own config.showLogs, so searches running side by side
+    // (library contexts, Python) never switch each other's logs
+    template <class... Args> void searchLog(Args... args) {
+        if (config.showLogs) {
+#pragma omp critical(output)
+            _debug("[DEBUG] ", args...);
+        }
+    }
+
+    // checked on every step, the clock is read only every few steps
+    inline bool timeExceeded() {
+        return cancelled.load(std::memory_order_relaxed) || deadline.expired(omp_thread_id);
+    }
+
+    inline bool growing() const {
+        return growingMatrix;
+    }
+
+    // number of analysed frames, grows while frames are appended to the trajectory
+    inline int matrixSize() {
+        return liveMatrixSize.load(std::memory_order_acquire);
+    }
+
+    // matrix size the search started with
+    int startMatrixSize;
+
+    // extending the matrix to frames published since the last call; returns true if it grew.
+    // Acquire/release on both counters makes coordinates of new frames visible to every thread
+    bool extendToNewFrames() {
+        if (!growingMatrix) {
+            return false;
+        }
+        int size = matrixSize();
+        int available = trajectory.available.load(std::memory_order_acquire);
+        if (available - config.frameFrom <= size) {
+            return false;
+        }
+        if (!liveMatrixSize.compare_exchange_strong(size, available - config.frameFrom, std::memory_order_acq_rel)) {
+            return false;
+        }
+        newFramesFrom.store(config.frameFrom + size, std::memory_order_relaxed);
+        if (config.showDebugCurrentBest) {
+            searchLog("[Frames]: ", available);
+        }
+        return true;
+    }
+
+    inline int randomFrame() {
+        return config.frameFrom + getRandom(0, matrixSize() - 1);
+    }
+
+    // with fingerprint index, starting pair is proposed by the index with fingerprintSeedChance;
+    // while the matrix grows, one frame of the pair is one of the newest frames with followNewFramesChance
+    void choosePairRandom(int &i, int &j) {
+        int newFrom = newFramesFrom.load(std::memory_order_relaxed);
+        int end = config.frameFrom + matrixSize();
+        if (newFrom < end && getRandom(1, 100) <= config.followNewFramesChance * 100) {
+            i = getRandom(newFrom, end - 1 - newFrom);
+            j = randomFrame();
+            while (i == j) {
+                j = randomFrame();
+            }
+            return;
+        }
+        if (index && getRandom(1, 100) <= config.fingerprintSeedChance * 100) {
+            index->proposePair(i, j);
+            if (insideMatrixBoundaries(i) && insideMatrixBoundaries(j)) {
+                return;
+            }
+        }
+        i = randomFrame();
+        j = randomFrame();
+        while (i == j) {
+            j = randomFrame();
+        }
+    }
+
+    // frame to jump to from allocation frame, the farthest one by fingerprint with fingerprintSeedChance
+    inline int jumpTarget(int allocatedOnFrame) {
+        if (index && getRandom(1, 100) <= config.fingerprintSeedChance * 100) {
+            int farthest = index->farthestFrame(allocatedOnFrame);
+            if (insideMatrixBoundaries(farthest)) {
+                return farthest;
+            }
+        }
+        return randomFrame();
+    }
+
+    // a route best above the incumbent is published at once, so the incumbent and its trace
+    // do not wait for the end of the route
+    inline bool saveIfRouteBest(LocalSearchResult &routeBest, double value, int i, int j) {
+        topK.offer(omp_thread_id, value, i, j);
+        if (value > routeBest.rmsdValue) {
+            routeBest = {
+                value,
+                i,
+                j,
+            };
+            if (config.showDebugRouteBest) {
+                searchLog("[Current route best]: [", i, ", ", j, "] = ", value);
+            }
+            if (value > incumbentValue.load(std::memory_order_relaxed)) {
+                routeGain[omp_thread_id] += saveIfBest(value, i, j);
+            }
+            return true;
+        }
+        return false;
+    }
+
+    // returns how much the incumbent improved, 0 if it did not
+    inline double saveIfBest(double value, int i, int j) {
+        double improvement = 0;
+#pragma omp critical(bestResult)
+        if (value > bestResult.rmsdValue) {
+            improvement = bestResult.rmsdValue < 0 ? value : value - bestResult.rmsdValue;
+            auto now = std::chrono::steady_clock::now();
+            std::chrono::duration<double> elapsed = now - start;
+            timeToBest = elapsed.count();
+            incumbentTrace.push_back({timeToBest, value});
+            if (bestResult.rmsdValue < 0) {
+                std::chrono::duration<double> sinceLoad = now - trajectory.loadStart;
+                timeToFirstResult = sinceLoad.count();
+            }
+            bestResult = {
+                value,
+                i,
+                j,
+            };
+            incumbentValue.store(value, std::memory_order_relaxed);
+            if (config.showDebugCurrentBest) {
+                searchLog("[Current best]: [", i, ", ", j, "] = ", value);
+            }
+        }
+        return improvement;
+    }
+
+    inline bool insideMatrixBoundaries(int &i) {
+        return i >= config.frameFrom && i < config.frameFrom + matrixSize();
+    }
+
+    inline bool identifiersGood(int &i, int &j) {
+        return insideMatrixBoundaries(j) && i != j;
+    }
+};
+
+#endif // EVALUATOR_H
@@ -2,14 +2,23 @@
 #define FILE_MANAGER_H
 
 #include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <string>
 #include <fstream>
+#include <iomanip>
 #include <sstream>
+#include <stdexcept>
+#include <vector>
 #include <unordered_map>
 
+#include "atom_selection.h"
 #include "progress.h"
+#include "RMSD_calculation.h"
+#include "sphere_map.h"
 #include "globals.h"
+#include "top_k.h"
+#include "trajectory.h"
 
 // trim from start (in place)
 static inline void ltrim(std::string &s) {
@@ -34,18 +43,370 @@ static inline void trim(std::string &s) {
 class FileManager {
 public:
 
-    //reading data from input pdb file.
-    int readTrajectory() {
-        const std::string& filename = config.trajectoryFilename;
+    // setting every known key of configMap in given config
+    static void applyConfigMap(Config &config, std::unordered_map<std::string, std::string> &configMap) {
+        if (configMap.find("trajectoryFilename") != configMap.end()) {
+            config.trajectoryFilename = configMap["trajectoryFilename"];
+        }
+        if (configMap.find("atomSelection") != configMap.end()) {
+            config.atomSelection = configMap["atomSelection"];
+        }
+        if (configMap.find("matrixSize") != configMap.end()) {
+            config.matrixSize = std::stoi(configMap["matrixSize"]);
+        }
+        if (configMap.find("frameFrom") != configMap.end()) {
+            config.frameFrom = std::stoi(configMap["frameFrom"]);
+        }
+        if (configMap.find("timeLimitMinutes") != configMap.end()) {
+            config.timeLimitMinutes = std::stod(configMap["timeLimitMinutes"]);
+        }
+        if (configMap.find("stopLatencyMs") != configMap.end()) {
+            config.stopLatencyMs = std::stod(configMap["stopLatencyMs"]);
+        }
+        if (configMap.find("showDebugCurrentBest") != configMap.end()) {
+            config.showDebugCurrentBest = configMap["showDebugCurrentBest"] == "true" ? true : false;
+        }
+        if (configMap.find("showDebugRouteBest") != configMap.end()) {
+            config.showDebugRouteBest = configMap["showDebugRouteBest"] == "true" ? true : false;
+        }
+        if (configMap.find("jumpFromLocalAreaChance") != configMap.end()) {
+            config.jumpFromLocalAreaChance = std::stod(configMap["jumpFromLocalAreaChance"]);
+        }
+        if (configMap.find("randomFrameWhileSwappingChance") != configMap.end()) {
+            config.randomFrameWhileSwappingChance = std::stod(configMap["randomFrameWhileSwappingChance"]);
+        }
+        if (configMap.find("randomSeed") != configMap.end()) {
+            config.randomSeed = configMap["randomSeed"] == "true" ? true : false;
+        }
+        if (configMap.find("ompThreadsPerCore") != configMap.end()) {
+            config.ompThreadsPerCore = std::stod(configMap["ompThreadsPerCore"]);
+        }
+        if (configMap.find("memorySize") != configMap.end()) {
+            config.memorySize = std::stod(configMap["memorySize"]);
+        }
+        if (configMap.find("writeAsCSV") != configMap.end()) {
+            config.writeAsCSV = configMap["writeAsCSV"] == "true" ? true : false;
+        }
+        if (configMap.find("showLogs") != configMap.end()) {
+            config.showLogs = configMap["showLogs"] == "true" ? true : false;
+        }
+        if (configMap.find("showRMSDCounter") != configMap.end()) {
+            config.showRMSDCounter = configMap["showRMSDCounter"] == "true" ? true : false;
+        }
+        if (configMap.find("runRepetitions") != configMap.end()) {
+            config.runRepetitions = std::stoi(configMap["runRepetitions"]);
+        }
+        if (configMap.find("topK") != configMap.end()) {
+            config.topK = std::stoi(configMap["topK"]);
+        }
+        if (configMap.find("topKMinSeparation") != configMap.end()) {
+            config.topKMinSeparation = std::stoi(configMap["topKMinSeparation"]);
+        }
+        if (configMap.find("writeAsJSON") != configMap.end()) {
+            config.writeAsJSON = configMap["writeAsJSON"] == "true" ? true : false;
+        }
+        if (configMap.find("searchStrategy") != configMap.end()) {
+            config.searchStrategy = configMap["searchStrategy"];
+        }
+        if (configMap.find("annealingTemperature") != configMap.end()) {
+            config.annealingTemperature = std::stod(configMap["annealingTemperature"]);
+        }
+        if (configMap.find("annealingCooling") != configMap.end()) {
+            config.annealingCooling = std::stod(configMap["annealingCooling"]);
+        }
+        if (configMap.find("tabuTenure") != configMap.end()) {
+            config.tabuTenure = std::stoi(configMap["tabuTenure"]);
+        }
+        if (configMap.find("tabuCandidates") != configMap.end()) {
+            config.tabuCandidates = std::stoi(configMap["tabuCandidates"]);
+        }
+        if (configMap.find("tabuPatience") != configMap.end()) {
+            config.tabuPatience = std::stoi(configMap["tabuPatience"]);
+        }
+        if (configMap.find("coarseScreening") != configMap.end()) {
+            config.coarseScreening = configMap["coarseScreening"] == "true" ? true : false;
+        }
+        if (configMap.find("coarseMargin") != configMap.end()) {
+            config.coarseMargin = std::stod(configMap["coarseMargin"]);
+        }
+        if (configMap.find("coarseSpheres") != configMap.end()) {
+            config.coarseSpheres = std::stoi(configMap["coarseSpheres"]);
+        }
+        if (configMap.find("ompThreads") != configMap.end()) {
+            config.ompThreads = std::stoi(configMap["ompThreads"]);
+        }
+        if (configMap.find("threadAffinity") != configMap.end()) {
+            config.threadAffinity = configMap["threadAffinity"];
+        }
+        if (configMap.find("numaPlacement") != configMap.end()) {
+            config.numaPlacement = configMap["numaPlacement"];
+        }
+        if (configMap.find("hugePages") != configMap.end()) {
+            config.hugePages = configMap["hugePages"];
+        }
+        if (configMap.find("coordinatePrecision") != configMap.end()) {
+            config.coordinatePrecision = configMap["coordinatePrecision"];
+        }
+        if (configMap.find("fixedSizeKernels") != configMap.end()) {
+            config.fixedSizeKernels = configMap["fixedSizeKernels"] == "true" ? true : false;
+        }
+        if (configMap.find("benchmarkKernels") != configMap.end()) {
+            config.benchmarkKernels = configMap["benchmarkKernels"] == "true" ? true : false;
+        }
+        if (configMap.find("sphereRadius") != configMap.end()) {
+            config.sphereRadius = std::stod(configMap["sphereRadius"]);
+        }
+        if (configMap.find("sphereRadii") != configMap.end()) {
+            config.sphereRadii = configMap["sphereRadii"];
+        }
+        if (configMap.find("verletSkin") != configMap.end()) {
+            config.verletSkin = std::stod(configMap["verletSkin"]);
+        }
+        if (configMap.find("fingerprintIndex") != configMap.end()) {
+            config.fingerprintIndex = configMap["fingerprintIndex"] == "true" ? true : false;
+        }
+        if (configMap.find("fingerprintSeedChance") != configMap.end()) {
+            config.fingerprintSeedChance = std::stod(configMap["fingerprintSeedChance"]);
+        }
+        if (configMap.find("fingerprintPairs") != configMap.end()) {
+            config.fingerprintPairs = std::stoi(configMap["fingerprintPairs"]);
+        }
+        if (configMap.find("residentCache") != configMap.end()) {
+            config.residentCache = configMap["residentCache"] == "true" ? true : false;
+        }
+        if (configMap.find("cachePairs") != configMap.end()) {
+            config.cachePairs = std::stoi(configMap["cachePairs"]);
+        }
+        if (configMap.find("cacheAllocations") != configMap.end()) {
+            config.cacheAllocations = std::stoi(configMap["cacheAllocations"]);
+        }
+        if (configMap.find("serveSocket") != configMap.end()) {
+            config.serveSocket = configMap["serveSocket"];
+        }
+        if (configMap.find("serveThreads") != configMap.end()) {
+            config.serveThreads = std::stoi(configMap["serveThreads"]);
+        }
+        if (configMap.find("sphereMap") != configMap.end()) {
+            config.sphereMap = configMap["sphereMap"] == "true" ? true : false;
+        }
+        if (configMap.find("sphereMapFilename") != configMap.end()) {
+            config.sphereMapFilename = configMap["sphereMapFilename"];
+        }
+        if (configMap.find("streamLoad") != configMap.end()) {
+            config.streamLoad = configMap["streamLoad"] == "true" ? true : false;
+        }
+        if (configMap.find("follow") != configMap.end()) {
+            config.follow = configMap["follow"] == "true" ? true : false;
+        }
+        if (configMap.find("followCapacity") != configMap.end()) {
+            config.followCapacity = std::stoi(configMap["followCapacity"]);
+        }
+        if (configMap.find("followPollSeconds") != configMap.end()) {
+            config.followPollSeconds = std::stod(configMap["followPollSeconds"]);
+        }
+        if (configMap.find("followNewFramesChance") != configMap.end()) {
+            config.followNewFramesChance = std::stod(configMap["followNewFramesChance"]);
+        }
+        if (configMap.find("autotune") != configMap.end()) {
+            config.autotune = configMap["autotune"] == "true" ? true : false;
+        }
+        if (configMap.find("autotuneSeeds") != configMap.end()) {
+            config.autotuneSeeds = std::stoi(configMap["autotuneSeeds"]);
+        }
+        if (configMap.find("autotuneFilename") != configMap.end()) {
+            config.autotuneFilename = configMap["autotuneFilename"];
+        }
+        if (configMap.find("intraPairThreads") != configMap.end()) {
+            config.intraPairThreads = std::stoi(configMap["intraPairThreads"]);
+        }
+        if (configMap.find("intraPairMinSpheres") != configMap.end()) {
+            config.intraPairMinSpheres = std::stoi(configMap["intraPairMinSpheres"]);
+        }
+        if (configMap.find("convergenceBenchmark") != configMap.end()) {
+            config.convergenceBenchmark = configMap["convergenceBenchmark"] == "true" ? true : false;
+        }
+        if (configMap.find("convergenceSeeds") != configMap.end()) {
+            config.convergenceSeeds = std::stoi(configMap["convergenceSeeds"]);
+        }
+        if (configMap.find("convergenceThreads") != configMap.end()) {
+            config.convergenceThreads = configMap["convergenceThreads"];
+        }
+        if (configMap.find("convergenceOptimum") != configMap.end()) {
+            config.convergenceOptimum = std::stod(configMap["convergenceOptimum"]);
+        }
+        if (configMap.find("convergenceTarget") != configMap.end()) {
+            config.convergenceTarget = std::stod(configMap["convergenceTarget"]);
+        }
+        if (configMap.find("convergenceFilename") != configMap.end()) {
+            config.convergenceFilename = configMap["convergenceFilename"];
+        }
+    }
+
+    // every key of config in the format read by readConfig(), the inverse of applyConfigMap()
+    static void writeConfig(const Config &config, std::ostream &out) {
+        std::ostringstream ss;
+        // 15 significant digits read back decimal values such as 0.1 unchanged
+        ss << std::setprecision(15);
+        ss << "trajectoryFilename: " << config.trajectoryFilename << std::endl;
+        ss << "atomSelection: " << config.atomSelection << std::endl;
+        ss << "matrixSize: " << config.matrixSize << std::endl;
+        ss << "frameFrom: " << config.frameFrom << std::endl;
+        ss << "timeLimitMinutes: " << config.timeLimitMinutes << std::endl;
+        ss << "stopLatencyMs: " << config.stopLatencyMs << std::endl;
+        ss << "showDebugCurrentBest: " << (config.showDebugCurrentBest ? "true" : "false") << std::endl;
+        ss << "showDebugRouteBest: " << (config.showDebugRouteBest ? "true" : "false") << std::endl;
+        ss << "jumpFromLocalAreaChance: " << config.jumpFromLocalAreaChance << std::endl;
+        ss << "randomFrameWhileSwappingChance: " << config.randomFrameWhileSwappingChance << std::endl;
+        ss << "randomSeed: " << (config.randomSeed ? "true" : "false") << std::endl;
+        ss << "ompThreadsPerCore: " << config.ompThreadsPerCore << std::endl;
+        ss << "memorySize: " << config.memorySize << std::endl;
+        ss << "writeAsCSV: " << (config.writeAsCSV ? "true" : "false") << std::endl;
+        ss << "showLogs: " << (config.showLogs ? "true" : "false") << std::endl;
+        ss << "showRMSDCounter: " << (config.showRMSDCounter ? "true" : "false") << std::endl;
+        ss << "runRepetitions: " << config.runRepetitions << std::endl;
+        ss << "topK: " << config.topK << std::endl;
+        ss << "topKMinSeparation: " << config.topKMinSeparation << std::endl;
+        ss << "writeAsJSON: " << (config.writeAsJSON ? "true" : "false") << std::endl;
+        ss << "searchStrategy: " << config.searchStrategy << std::endl;
+        ss << "annealingTemperature: " << config.annealingTemperature << std::endl;
+        ss << "annealingCooling: " << config.annealingCooling << std::endl;
+        ss << "tabuTenure: " << config.tabuTenure << std::endl;
+        ss << "tabuCandidates: " << config.tabuCandidates << std::endl;
+        ss << "tabuPatience: " << config.tabuPatience << std::endl;
+        ss << "coarseScreening: " << (config.coarseScreening ? "true" : "false") << std::endl;
+        ss << "coarseMargin: " << config.coarseMargin << std::endl;
+        ss << "coarseSpheres: " << config.coarseSpheres << std::endl;
+        ss << "ompThreads: " << config.ompThreads << std::endl;
+        ss << "threadAffinity: " << config.threadAffinity << std::endl;
+        ss << "numaPlacement: " << config.numaPlacement << std::endl;
+        ss << "hugePages: " << config.hugePages << std::endl;
+        ss << "coordinatePrecision: " << config.coordinatePrecision << std::endl;
+        ss << "fixedSizeKernels: " << (config.fixedSizeKernels ? "true" : "false") << std::endl;
+        ss << "benchmarkKernels: " << (config.benchmarkKernels ? "true" : "false") << std::endl;
+        ss << "sphereRadius: " << config.sphereRadius << std::endl;
+        ss << "sphereRadii: " << config.sphereRadii << std::endl;
+        ss << "verletSkin: " << config.verletSkin << std::endl;
+        ss << "fingerprintIndex: " << (config.fingerprintIndex ? "true" : "false") << std::endl;
+        ss << "fingerprintSeedChance: " << config.fingerprintSeedChance << std::endl;
+        ss << "fingerprintPairs: " << config.fingerprintPairs << std::endl;
+        ss << "residentCache: " << (config.residentCache ? "true" : "false") << std::endl;
+        ss << "cachePairs: " << config.cachePairs << std::endl;
+        ss << "cacheAllocations: " << config.cacheAllocations << std::endl;
+        ss << "serveSocket: " << config.serveSocket << std::endl;
+        ss << "serveThreads: " << config.serveThreads << std::endl;
+        ss << "sphereMap: " << (config.sphereMap ? "true" : "false") << std::endl;
+        ss << "sphereMapFilename: " << config.sphereMapFilename << std::endl;
+        ss << "streamLoad: " << (config.streamLoad ? "true" : "false") << std::endl;
+        ss << "follow: " << (config.follow ? "true" : "false") << std::endl;
+        ss << "followCapacity: " << config.followCapacity << std::endl;
+        ss << "followPollSeconds: " << config.followPollSeconds << std::endl;
+        ss << "followNewFramesChance: " << config.followNewFramesChance << std::endl;
+        ss << "autotune: " << (config.autotune ? "true" : "false") << std::endl;
+        ss << "autotuneSeeds: " << config.autotuneSeeds << std::endl;
+        ss << "autotuneFilename: " << config.autotuneFilename << std::endl;
+        ss << "intraPairThreads: " << config.intraPairThreads << std::endl;
+        ss << "intraPairMinSpheres: " << config.intraPairMinSpheres << std::endl;
+        ss << "convergenceBenchmark: " << (config.convergenceBenchmark ? "true" : "false") << std::endl;
+        ss << "convergenceSeeds: " << config.convergenceSeeds << std::endl;
+        ss << "convergenceThreads: " << config.convergenceThreads << std::endl;
+        ss << "convergenceOptimum: " << config.convergenceOptimum << std::endl;
+        ss << "convergenceTarget: " << config.convergenceTarget << std::endl;
+        ss << "convergenceFilename: " << config.convergenceFilename << std::endl;
+        out << ss.str();
+    }
+
+private:
+
+    // reading "key: value" lines, skipping comments
+    static bool readConfigMap(const std::string &filename, std::unordered_map<std::string, std::string> &configMap) {
+        std::ifstream file(filename);
+        if (!file.is_open()) {
+            return false;
+        }
+        std::string line;
+        while (getline(file, line)) {
+            if (line[0] == '#') {
+                continue;
+            }
+            std::istringstream iss(line);
+            std::string key, value;
+            std::getline(iss, key, ':');
+            std::getline(iss, value);
+            trim(key);
+            trim(value);
+            configMap[key] = value;
+        }
+        file.close();
+        return true;
+    }
+
+    // expanding "from:to:step" range or "a, b, c" list into separate values
+    static std::vector<std::string> expandSweep(const std::string &value) {
+        std::vector<std::string> values;
+        if (std::count(value.begin(), value.end(), ':') == 2) {
+            std::istringstream iss(value);
+            std::string from, to, step;
+            std::getline(iss, from, ':');
+            std::getline(iss, to, ':');
+            std::getline(iss, step);
+            double f = std::stod(from), t = std::stod(to), st = std::stod(step);
+            if (st <= 0) {
+                throw std::runtime_error("Sweep step has to be positive: " + value);
+            }
+            for (int n = 0; f + n * st <= t + st * 1e-6; n++) {
+                std::ostringstream oss;
+                oss << f + n * st;
+                values.push_back(oss.str());
+            }
+            return values;
+        }
+        std::istringstream iss(value);
+        std::string item;
+        while (std::getline(iss, item, ',')) {
+            trim(item);
+            if (!item.empty()) {
+                values.push_back(item);
+            }
+        }
+        return values;
+    }
+
+public:
+
+    //reading data from input pdb file into trajectory, coordinates are placed as set in config
+    // only atoms selected by config.atomSelection are stored, numbered in file order
+    int readTrajectory(const Config &config, Trajectory &trajectory) {
+        const std::string &filename = config.trajectoryFilename;
         if (DEBUG) {
             std::cout << "Reading file: " << filename << std::endl;
         }
+        trajectory.loadStart = std::chrono::steady_clock::now();
+        AtomSelection selection;
+        std::string selectionError;
+        if (!selection.parse(config.atomSelection, selectionError)) {
+            if (DEBUG) {
+                std::cout << "Invalid atom selection \"" << config.atomSelection << "\": " << selectionError << std::endl;
+            }
+            return 1;
+        }
         std::string line;
         std::ifstream file1(filename);
         int lines_count = 0;
+        int frames_count = 0;
+        trajectory.sphereCA = {};
+        trajectory.sphereResidues = {};
         if (file1.is_open()) {
             while (getline(file1, line)) {
                 lines_count++;
+                if (line[0] == 'M') {
+                    frames_count++;
+                } else if (line[0] == 'A' && frames_count == 1) {
+                    int atom = selection.select(line);
+                    if (atom >= 0 && line[14] == 'A' and line[13] == 'C') {
+                        trajectory.sphereCA.push_back(atom);
+                        trajectory.sphereResidues.push_back(stoi(line.substr(22, 4)));
+                    }
+                }
             }
             file1.close();
         } else {
@@ -54,45 +415,59 @@ public:
             }
             return 1;
         }
+        if (trajectory.sphereCA.empty()) {
+            if (DEBUG) {
+                std::cout << "Atom selection \"" << config.atomSelection << "\" has no CA atoms to center spheres on" << std::endl;
+            }
+            return 1;
+        }
         Progress p1(lines_count);
         std::ifstream file(filename);
         if (file.is_open()) {
             int frame = 0;
             int atom;
-            SPHERES = 0;
-            FRAMES = 0;
-            ATOMS = 0;
-            A = {};
-            sphereCA = {};
-            // sphereSize = {};
+            CoordinateStore &A = trajectory.A;
+            trajectory.frames = 0;
+            trajectory.atoms = selection.selected();
+            trajectory.atomsInFile = selection.total();
+            trajectory.spheres = trajectory.sphereCA.size();
+            trajectory.selection = config.atomSelection;
+            if (!A.allocate(frames_count, trajectory.atoms, config.numaPlacement, config.hugePages)) {
+                if (DEBUG) {
+                    std::cout << "Cannot allocate coordinates of " << frames_count << " frames" << std::endl;
+                }
+                return 1;
+            }
             while (getline(file, line)) {
                 p1.improve();
                 if (line[0] == 'M') {
                     frame = stoi(line.substr(9, 5));
                     frame--;
-                    A.push_back({});
-                    FRAMES++;
+                    trajectory.frames++;
                 } else if (line[0] == 'A') {
-                    atom = stoi(line.substr(6, 5));
-                    atom--;
-                    A[frame].push_back({});
-                    A[frame][atom].push_back(stod(line.substr(30, 8)));
-                    A[frame][atom].push_back(stod(line.substr(38, 8)));
-                    A[frame][atom].push_back(stod(line.substr(46, 8)));
-                    if (frame == 0) {
-                        ATOMS++;
-                        if (line[14] == 'A' and line[13] == 'C') {
-                            sphereCA.push_back(atom);
-                            // sphereSize.push_back(0);
-                            SPHERES++;
-                        }
+                    atom = selection.slot(stoi(line.substr(6, 5)) - 1);
+                    if (atom < 0) {
+                        continue;
                     }
+                    A[frame][atom][0] = stod(line.substr(30, 8));
+                    A[frame][atom][1] = stod(line.substr(38, 8));
+                    A[frame][atom][2] = stod(line.substr(46, 8));
                 }
             }
             p1.end();
             file.close();
+            trajectory.available = trajectory.frames;
+            if (config.coordinatePrecision == "int16" && !quantiseCoordinates(trajectory)) {
+                return 1;
+            }
+            A.replicate();
+            std::chrono::duration<double> loadElapsed = std::chrono::steady_clock::now() - trajectory.loadStart;
+            trajectory.loadSeconds = loadElapsed.count();
             if (DEBUG) {
                 std::cout << "File parsed" << std::endl;
+                std::cout << "Atoms: " << trajectory.atoms << " of " << trajectory.atomsInFile << " selected by \""
+                          << trajectory.selection << "\", " << trajectory.spheres << " spheres" << std::endl;
+                printPlacement(A);
             }
             return 0;
         } else {
@@ -103,67 +478,56 @@ public:
         }
     }
 
-    bool readConfig(const std::string& filename) {
-        std::ifstream file(filename);
-        if (file.is_open()) {
-            std::string line;
-            std::unordered_map<std::string, std::string> configMap;
-            while (getline(file, line)) {
-                if (line[0] == '#') {
-                    continue;
-                }
-                std::istringstream iss(line);
-                std::string key, value;
-                std::getline(iss, key, ':');
-                std::getline(iss, value);
-                trim(key);
-                trim(value);
-                configMap[key] = value;
-            }
-
-            if (configMap.find("trajectoryFilename") != configMap.end()) {
-                config.trajectoryFilename = configMap["trajectoryFilename"];
-            }
-            if (configMap.find("matrixSize") != configMap.end()) {
-                config.matrixSize = std::stoi(configMap["matrixSize"]);
-            }
-            if (configMap.find("timeLimitMinutes") != configMap.end()) {
-                config.timeLimitMinutes = std::stod(configMap["timeLimitMinutes"]);
-            }
-            if (configMap.find("showDebugCurrentBest") != configMap.end()) {
-                config.showDebugCurrentBest = configMap["showDebugCurrentBest"] == "true" ? true : false;
-            }
-            if (configMap.find("showDebugRouteBest") != configMap.end()) {
-                config.showDebugRouteBest = configMap["showDebugRouteBest"] == "true" ? true : false;
-            }
-            if (configMap.find("jumpFromLocalAreaChance") != configMap.end()) {
-                config.jumpFromLocalAreaChance = std::stod(configMap["jumpFromLocalAreaChance"]);
-            }
-            if (configMap.find("randomFrameWhileSwappingChance") != configMap.end()) {
-                config.randomFrameWhileSwappingChance = std::stod(configMap["randomFrameWhileSwappingChance"]);
-            }
-            if (configMap.find("randomSeed") != configMap.end()) {
-                config.randomSeed = configMap["randomSeed"] == "true" ? true : false;
-            }
-            if (configMap.find("ompThreadsPerCore") != configMap.end()) {
-                config.ompThreadsPerCore = std::stod(configMap["ompThreadsPerCore"]);
-            }
-            if (configMap.find("memorySize") != configMap.end()) {
-                config.memorySize = std::stod(configMap["memorySize"]);
-            }
-            if (configMap.find("writeAsCSV") != configMap.end()) {
-                config.writeAsCSV = configMap["writeAsCSV"] == "true" ? true : false;
-            }
-            if (configMap.find("showLogs") != configMap.end()) {
-                config.showLogs = configMap["showLogs"] == "true" ? true : false;
+    // replacing double coordinates with their int16 copy; the copy is measured against the doubles
+    // on sampled pairs first, so the error it causes is reported before the doubles are gone
+    static bool quantiseCoordinates(Trajectory &trajectory) {
+        const int SAMPLED_PAIRS = 32;
+        CoordinateStore quantised;
+        if (!quantised.quantiseFrom(trajectory.A)) {
+            if (DEBUG) {
+                std::cout << "Cannot allocate quantised coordinates" << std::endl;
             }
-            if (configMap.find("showRMSDCounter") != configMap.end()) {
-                config.showRMSDCounter = configMap["showRMSDCounter"] == "true" ? true : false;
+            return false;
+        }
+        if (DEBUG) {
+            double maxAtomError = 0;
+            for (int f = 0; f < trajectory.frames; f++) {
+                maxAtomError = std::max(maxAtomError, quantised.maxError(f));
             }
-            if (configMap.find("runRepetitions") != configMap.end()) {
-                config.runRepetitions = std::stoi(configMap["runRepetitions"]);
+            double sameSpheresDifference, maxDifference, maxRelative, maxBound;
+            RMSDCalculation rmsd(trajectory);
+            rmsd.quantisationError(quantised, SAMPLED_PAIRS, sameSpheresDifference, maxDifference, maxRelative, maxBound);
+            std::cout << "Quantised coordinates: " << quantised.memoryBytes() << " bytes instead of " << trajectory.A.memoryBytes()
+                      << ", max atom error " << maxAtomError << " A" << std::endl;
+            std::cout << "RMSD error on " << SAMPLED_PAIRS << " sampled pairs: max " << sameSpheresDifference << " on the same spheres (bound "
+                      << maxBound << "), max " << maxDifference << " (" << maxRelative * 100 << "% of the value) with spheres allocated on quantised coordinates" << std::endl;
+        }
+        trajectory.A.swap(quantised);
+        return true;
+    }
+
+    // NUMA nodes, huge pages and pages of coordinates on every node
+    static void printPlacement(CoordinateStore &A) {
+        NumaTopology &topology = numaTopology();
+        std::cout << "Coordinates: " << A.memoryBytes() << " bytes, NUMA nodes: " << topology.nodes()
+                  << ", placement: " << A.placement << ", huge pages: " << A.hugePages << std::endl;
+        std::vector<std::vector<int>> pages = A.pagesPerNode();
+        for (size_t r = 0; r < pages.size(); r++) {
+            std::cout << " - copy " << r << " sampled pages per node:";
+            for (int count : pages[r]) {
+                std::cout << " " << count;
             }
-            
+            std::cout << std::endl;
+        }
+    }
+
+    bool readConfig(const std::string& filename, Config &config) {
+        std::unordered_map<std::string, std::string> configMap;
+        if (readConfigMap(filename, configMap)) {
+            // keys missing in the file keep their default values
+            config.initDefault();
+            applyConfigMap(config, configMap);
+
             DEBUG = config.showLogs;
             DEBUG_RMSD = config.showRMSDCounter;
 
@@ -171,7 +535,6 @@ public:
                 std::cout << "Reading file: " << filename << std::endl;
             }
 
-            file.close();
             if (DEBUG) {
                 std::cout << "Config file loaded" << std::endl;
             }
@@ -184,7 +547,99 @@ public:
         }
     }
 
-    static void writeResultsAsCSV(int bestI, int bestJ, double bestValue, double elapsedTime) {
+    // batch file lists base configs ("config: FILE", may repeat), the pool size ("threads: NUM")
+    // and any config keys; a key with a "from:to:step" range or "a, b, c" list is swept.
+    // Every base config is combined with every sweep point and repeated runRepetitions times.
+    bool readBatch(const std::string &filename, std::vector<Config> &jobs, int &threads) {
+        std::ifstream file(filename);
+        if (!file.is_open()) {
+            if (DEBUG) {
+                std::cout << "Cannot find batch file: " << filename << std::endl;
+            }
+            return false;
+        }
+        std::vector<std::string> configFilenames;
+        std::vector<std::pair<std::string, std::vector<std::string>>> sweeps;
+        threads = 0;
+        // logs are global, so showLogs applies to the whole batch and is never swept
+        bool showLogs = DEBUG;
+        std::string line;
+        while (getline(file, line)) {
+            if (line.empty() || line[0] == '#') {
+                continue;
+            }
+            std::istringstream iss(line);
+            std::string key, value;
+            std::getline(iss, key, ':');
+            std::getline(iss, value);
+            trim(key);
+            trim(value);
+            if (key.empty()) {
+                continue;
+            } else if (key == "config") {
+                configFilenames.push_back(value);
+            } else if (key == "threads") {
+                threads = std::stoi(value);
+            } else if (key == "showLogs") {
+                showLogs = value == "true";
+            } else {
+                sweeps.push_back({key, key == "trajectoryFilename" ? std::vector<std::string>{value} : expandSweep(value)});
+            }
+        }
+        file.close();
+
+        std::vector<Config> bases;
+        if (configFilenames.empty()) {
+            Config base;
+            base.initDefault();
+            bases.push_back(base);
+        }
+        for (const std::string &configFilename : configFilenames) {
+            std::unordered_map<std::string, std::string> configMap;
+            if (!readConfigMap(configFilename, configMap)) {
+                if (DEBUG) {
+                    std::cout << "Cannot find config file: " << configFilename << std::endl;
+                }
+                return false;
+            }
+            Config base;
+            base.initDefault();
+            applyConfigMap(base, configMap);
+            bases.push_back(base);
+        }
+
+        // cartesian product of all sweep values
+        std::vector<Config> points = bases;
+        for (const auto &sweep : sweeps) {
+            std::vector<Config> expanded;
+            for (const Config &point : points) {
+                for (const std::string &value : sweep.second) {
+                    std::unordered_map<std::string, std::string> configMap = {{sweep.first, value}};
+                    Config c = point;
+                    applyConfigMap(c, configMap);
+                    expanded.push_back(c);
+                }
+            }
+            points.swap(expanded);
+        }
+
+        jobs.clear();
+        for (Config &point : points) {
+            point.showLogs = showLogs;
+            for (int r = 0; r < point.runRepetitions; r++) {
+                jobs.push_back(point);
+            }
+        }
+        DEBUG = showLogs;
+        if (DEBUG) {
+            std::cout << "Batch file loaded: " << jobs.size() << " runs" << std::endl;
+        }
+        return true;
+    }
+
+    // top K pairs are written in one field as "i,j,rmsd|i,j,rmsd|..."
+    static void writeResultsAsCSV(const Config &config, int bestI, int bestJ, double bestValue, double elapsedTime,
+                                  const std::vector<TopKPairs::Entry> &topPairs) {
 
         std::cout
             << "local_search;" 
@@ -202,8 +657,95 @@ public:
             << bestI << ";"
             << bestJ << ";"
             << bestValue << ";"
-            << elapsedTime
-        << std::endl;
+            << elapsedTime << ";";
+        for (size_t k = 0; k < topPairs.size(); k++) {
+            std::cout << (k ? "|" : "") << topPairs[k].i << "," << topPairs[k].j << "," << topPairs[k].rmsdValue;
+        }
+        std::cout << std::endl;
+    }
+
+    // one line per sphere: residue of its CA, maximum over evaluated pairs with its pair, and RMSD for every top pair
+    static bool writeSphereMap(const Config &config, const Trajectory &trajectory, const std::vector<TopKPairs::Entry> &topPairs,
+                               const SphereMap &sphereMap) {
+        std::ofstream file(config.sphereMapFilename);
+        if (!file.is_open()) {
+            if (DEBUG) {
+                std::cout << "Cannot write sphere map: " << config.sphereMapFilename << std::endl;
+            }
+            return false;
+        }
+        file << "sphere;residue;max;maxI;maxJ";
+        for (const TopKPairs::Entry &e : topPairs) {
+            file << ";" << e.i << "-" << e.j;
+        }
+        file << std::endl;
+        for (int s = 0; s < (int)sphereMap.maxima.size(); s++) {
+            file << s << ";";
+            if (s < (int)trajectory.sphereResidues.size()) {
+                file << trajectory.sphereResidues[s];
+            }
+            file << ";" << sphereMap.maxima[s] << ";" << sphereMap.maximaI[s] << ";" << sphereMap.maximaJ[s];
+            for (const std::vector<double> &pair : sphereMap.pairs) {
+                file << ";" << pair[s];
+            }
+            file << std::endl;
+        }
+        return true;
+    }
+
+    // text as a quoted JSON string, quotes, backslashes and control characters escaped
+    static std::string jsonString(const std::string &text) {
+        static const char hex[] = "0123456789abcdef";
+        std::string quoted = "\"";
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                quoted += '\\';
+                quoted += c;
+            } else if (c == '\n') {
+                quoted += "\\n";
+            } else if (c == '\r') {
+                quoted += "\\r";
+            } else if (c == '\t') {
+                quoted += "\\t";
+            } else if ((unsigned char)c < 0x20) {
+                quoted += "\\u00";
+                quoted += hex[(unsigned char)c >> 4];
+                quoted += hex[c & 0xf];
+            } else {
+                quoted += c;
+            }
+        }
+        quoted += '"';
+        return quoted;
+    }
+
+    // atoms, coordinates memory and RMSD rate are reported for the atom selection of the trajectory
+    static void writeResultsAsJSON(const Config &config, int bestI, int bestJ, double bestValue, double elapsedTime,
+                                   const std::vector<TopKPairs::Entry> &topPairs, const Trajectory &trajectory, double rmsdPerSecond) {
+        std::cout
+            << "{\"trajectory\": " << jsonString(config.trajectoryFilename) << ", "
+            << "\"atomSelection\": " << jsonString(trajectory.selection) << ", "
+            << "\"atoms\": " << trajectory.atoms << ", "
+            << "\"atomsInFile\": " << trajectory.atomsInFile << ", "
+            << "\"coordinatePrecision\": \"" << (trajectory.A.quantised() ? "int16" : "double") << "\", "
+            << "\"coordinatesBytes\": " << trajectory.A.memoryBytes() << ", "
+            << "\"framesDropped\": " << trajectory.framesDropped << ", "
+            << "\"rmsdPerSecond\": " << rmsdPerSecond << ", "
+            << "\"timeLimitMinutes\": " << config.timeLimitMinutes << ", "
+            << "\"ompThreadsPerCore\": " << config.ompThreadsPerCore << ", "
+            << "\"jumpFromLocalAreaChance\": " << config.jumpFromLocalAreaChance << ", "
+            << "\"randomFrameWhileSwappingChance\": " << config.randomFrameWhileSwappingChance << ", "
+            << "\"memorySize\": " << config.memorySize << ", "
+            << "\"matrixSize\": " << config.matrixSize << ", "
+            << "\"searchStrategy\": " << jsonString(config.searchStrategy) << ", "
+            << "\"best\": {\"i\": " << bestI << ", \"j\": " << bestJ << ", \"rmsd\": " << bestValue << "}, "
+            << "\"elapsedTime\": " << elapsedTime << ", "
+            << "\"topK\": [";
+        for (size_t k = 0; k < topPairs.size(); k++) {
+            std::cout << (k ? ", " : "")
+                      << "{\"i\": " << topPairs[k].i << ", \"j\": " << topPairs[k].j << ", \"rmsd\": " << topPairs[k].rmsdValue << "}";
+        }
+        std::cout << "]}" << std::endl;
     }
 };
 
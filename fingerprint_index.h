@@ -0,0 +1,152 @@
+#ifndef FINGERPRINT_INDEX_H
+#define FINGERPRINT_INDEX_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+#include <omp.h>
+
+#include "globals.h"
+#include "trajectory.h"
+
+// Approximate farthest-pair index over compact frame fingerprints.
+// Fingerprint of a frame is a sketch of its CA distance matrix: distances between fixed random CA pairs.
+// Frames with distant fingerprints are structurally different, so the most distant fingerprint pairs
+// are good starting pairs for routes, and the most distant frame of a frame is a good jump target.
+class FingerprintIndex {
+  public:
+    struct Candidate {
+        float distance;
+        int i;
+        int j;
+    };
+
+  private:
+    static const int SKETCH_SIZE = 32;
+    // every frame is compared with at most this many frames
+    static const int SAMPLES = 2048;
+
+    int frames;
+    // fingerprints [<frame>][<sketch>]
+    std::vector<float> fingerprints;
+    // farthest found frame for every frame
+    std::vector<int> farthest;
+    // the most distant pairs, sorted from the most distant one
+    std::vector<Candidate> candidates;
+
+    static bool greater(const Candidate &a, const Candidate &b) {
+        return a.distance > b.distance;
+    }
+
+    inline float fingerprintDistance(int f1, int f2) {
+        const float *a = &fingerprints[(size_t)f1 * SKETCH_SIZE];
+        const float *b = &fingerprints[(size_t)f2 * SKETCH_SIZE];
+        float result = 0;
+        for (int k = 0; k < SKETCH_SIZE; k++) {
+            float d = a[k] - b[k];
+            result += d * d;
+        }
+        return result;
+    }
+
+  public:
+    bool enabled;
+    double buildSeconds;
+
+    FingerprintIndex() : frames(0), enabled(false), buildSeconds(0) {}
+
+    // building fingerprints of first framesCount frames and keeping pairsCount the most distant pairs
+    void build(const Trajectory &trajectory, int framesCount, int pairsCount) {
+        const CoordinateStore &A = trajectory.A;
+        auto buildStart = std::chrono::steady_clock::now();
+        enabled = true;
+        frames = framesCount;
+
+        // fixed seed, so the same trajectory always gets the same fingerprints
+        std::mt19937 generator(0);
+        std::uniform_int_distribution<int> sphereDistribution(0, trajectory.spheres - 1);
+        std::vector<std::pair<int, int>> sketchPairs(SKETCH_SIZE);
+        for (auto &p : sketchPairs) {
+            p.first = trajectory.sphereCA[sphereDistribution(generator)];
+            p.second = trajectory.sphereCA[sphereDistribution(generator)];
+        }
+        fingerprints.assign((size_t)frames * SKETCH_SIZE, 0);
+        for (int f = 0; f < frames; f++) {
+            for (int k = 0; k < SKETCH_SIZE; k++) {
+                double dx = A.at(f, sketchPairs[k].first, 0) - A.at(f, sketchPairs[k].second, 0);
+                double dy = A.at(f, sketchPairs[k].first, 1) - A.at(f, sketchPairs[k].second, 1);
+                double dz = A.at(f, sketchPairs[k].first, 2) - A.at(f, sketchPairs[k].second, 2);
+                fingerprints[(size_t)f * SKETCH_SIZE + k] = sqrt(dx*dx + dy*dy + dz*dz);
+            }
+        }
+
+        // comparing every frame with all other frames, or with a strided sample of them
+        int samples = std::min(frames, SAMPLES);
+        int stride = std::max(1, frames / samples);
+        int keep = std::max(pairsCount, 1);
+        farthest.assign(frames, 0);
+        std::vector<std::vector<Candidate>> heaps(omp_get_max_threads());
+#pragma omp parallel for schedule(dynamic, 16)
+        for (int f = 0; f < frames; f++) {
+            std::vector<Candidate> &heap = heaps[omp_get_thread_num()];
+            Candidate best = {-1, f, f};
+            for (int s = 0; s < samples; s++) {
+                int g = (s * stride + f % stride) % frames;
+                if (g == f) {
+                    continue;
+                }
+                float d = fingerprintDistance(f, g);
+                if (d > best.distance) {
+                    best = {d, f, g};
+                }
+                if (g < f) {
+                    continue;
+                }
+                if ((int)heap.size() < keep) {
+                    heap.push_back({d, f, g});
+                    std::push_heap(heap.begin(), heap.end(), greater);
+                } else if (d > heap.front().distance) {
+                    std::pop_heap(heap.begin(), heap.end(), greater);
+                    heap.back() = {d, f, g};
+                    std::push_heap(heap.begin(), heap.end(), greater);
+                }
+            }
+            farthest[f] = best.j;
+        }
+        candidates.clear();
+        for (auto &heap : heaps) {
+            candidates.insert(candidates.end(), heap.begin(), heap.end());
+        }
+        std::sort(candidates.begin(), candidates.end(), greater);
+        if ((int)candidates.size() > keep) {
+            candidates.resize(keep);
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - buildStart;
+        buildSeconds = elapsed.count();
+    }
+
+    // random pair out of the most distant ones, (i, j) or (j, i)
+    void proposePair(int &i, int &j) const {
+        const Candidate &c = candidates[getRandom(0, candidates.size() - 1)];
+        if (getRandom(0, 1)) {
+            i = c.i;
+            j = c.j;
+        } else {
+            i = c.j;
+            j = c.i;
+        }
+    }
+
+    inline int farthestFrame(int frame) const {
+        return farthest[frame];
+    }
+
+    size_t memoryBytes() const {
+        return fingerprints.size() * sizeof(float) + farthest.size() * sizeof(int) + candidates.size() * sizeof(Candidate);
+    }
+};
+
+#endif // FINGERPRINT_INDEX_H
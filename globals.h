@@ -1,58 +1,93 @@
 #ifndef GLOBALS_H
 #define GLOBALS_H
 
+#include <cstdlib>
 #include <iostream>
 #include <random>
+#include <string>
 #include <unordered_set>
 #include <vector>
 #include <omp.h>
 
 extern bool DEBUG;
 extern bool DEBUG_RMSD;
-extern int RMSDCalculationCount;
-extern int AllocationsCount;
 extern bool AlreadyShowedRMSDCalculationCount;
+// index of the thread inside the search it works for, selects per-thread state of that search
 extern int omp_thread_id;
-
-extern double sphereRadius;
-extern int SPHERES;
-extern int ATOMS;
-extern int FRAMES;
-extern int FRAMEONE;
-extern int FRAMETWO;
+// random generator state of the calling thread, every search thread is seeded with seedRandom()
+extern unsigned random_state;
 
 #pragma omp threadprivate(\
-    RMSDCalculationCount,\
-    AllocationsCount,\
     AlreadyShowedRMSDCalculationCount,\
     omp_thread_id,\
-    FRAMEONE,\
-    FRAMETWO)
-
-// Atoms[<frame>][<atom>][<coordinate>]
-extern std::vector<std::vector<std::vector<double>>> A;
-
-// Maps sphere to CA; CAAtomNumber[<sphere>]
-extern std::vector<int> sphereCA;
-
-// List of atoms in [<sphere>]
-extern std::vector<std::vector<int>>* sphereAtoms;
+    random_state)
 
 struct Config {
     std::string trajectoryFilename;             // trajectory filename
+    std::string atomSelection;                  // atoms kept at load, e.g. all, backbone, heavy and chain A
     int matrixSize;                             // analysing first [matrixSize] frames of pairs matrix
+    int frameFrom;                              // first analysed frame, frames [frameFrom, frameFrom + matrixSize)
     double timeLimitMinutes;                    // max time for whole local search to finish
+    double stopLatencyMs;                       // target delay of stopping after the time limit, clock is read about this often
     bool showDebugCurrentBest;                  // showing current best value
     bool showDebugRouteBest;                    // showing current route best value
     double jumpFromLocalAreaChance;             // probability of jumping from local area
     double randomFrameWhileSwappingChance;      // probability of choosing random frame while swapping allocations
     bool randomSeed;                            // random seed for srand()
     double ompThreadsPerCore;                   // omp threads number per one cpu core
+    int ompThreads;                             // omp threads number, overrides ompThreadsPerCore if > 0
+    std::string threadAffinity;                 // none, compact or spread over NUMA nodes
+    std::string numaPlacement;                  // coordinates placement: none, interleave or replicate
+    std::string hugePages;                      // coordinates backed by huge pages: none, transparent or explicit
+    std::string coordinatePrecision;            // stored coordinates: double or int16 (fixed point per frame, a quarter of the memory)
     double memorySize;                          // [0, 1] where 0 is no memory, and 1 is remembering whole matrix
     bool writeAsCSV;                            // each run of a program generates one line in CSV format
     bool showLogs;                              // show logs in the console
     bool showRMSDCounter;                       // show rsmd counter in the console
     int runRepetitions;                         // program execution repetition number
+    int topK;                                   // number of the most deviating pairs to report
+    int topKMinSeparation;                      // min frame distance between reported pairs, 0 to disable
+    bool sphereMap;                             // per-sphere RMSD of the top pairs and per-sphere maximum over evaluated pairs
+    std::string sphereMapFilename;              // CSV file the sphere map is written to
+    bool writeAsJSON;                           // each run of a program generates one line in JSON format
+    std::string searchStrategy;                 // localSearch, annealing, tabu or portfolio
+    double annealingTemperature;                // starting temperature as a fraction of route starting value
+    double annealingCooling;                    // temperature multiplier after every annealing move
+    int tabuTenure;                             // number of iterations a visited pair stays tabu
+    int tabuCandidates;                         // neighbours evaluated in every tabu iteration
+    int tabuPatience;                           // tabu iterations without improvement ending a route
+    bool coarseScreening;                       // fully evaluating only pairs with promising coarse score
+    double coarseMargin;                        // how far below the value to beat a coarse score may be
+    int coarseSpheres;                          // number of representative spheres in coarse score, 0 means all
+    bool fixedSizeKernels;                      // calculating spheres up to 256 atoms with compile-time sized kernels
+    bool benchmarkKernels;                      // benchmarking fixed size kernels against the dynamic path instead of searching
+    double sphereRadius;                        // atoms within this distance from a CA in angstroms form its sphere
+    std::string sphereRadii;                    // comma separated radii scored together with sphereRadius in one pass, empty to disable
+    double verletSkin;                          // neighbour list margin beyond sphereRadius in angstroms, 0 to disable
+    bool fingerprintIndex;                      // seeding routes and jumps from frame fingerprint index
+    double fingerprintSeedChance;               // probability of taking starting pair or jump target from the index
+    int fingerprintPairs;                       // number of the most distant fingerprint pairs kept in the index
+    bool residentCache;                         // keeping pair values and allocations for later searches on the trajectory
+    int cachePairs;                             // max number of pair values in resident cache
+    int cacheAllocations;                       // max number of frame allocations in resident cache
+    std::string serveSocket;                    // serving searches on this Unix socket instead of searching, if not empty
+    int serveThreads;                           // threads shared by all served searches, 0 means all cpu cores
+    bool streamLoad;                            // searching while the trajectory is read on a background thread
+    bool follow;                                // tailing a trajectory file which is still being written
+    int followCapacity;                         // max number of frames kept while following
+    double followPollSeconds;                   // how long to wait for new frames once the end of file is reached
+    double followNewFramesChance;               // probability of starting a route at a pair with one of the newest frames
+    bool autotune;                              // tuning jump, random frame and memory parameters for timeLimitMinutes instead of searching
+    int autotuneSeeds;                          // seeds every autotune candidate is tried with in every round
+    std::string autotuneFilename;               // config file the tuned parameters are written to
+    int intraPairThreads;                       // threads calculating spheres of one pair, 0 to choose from system size, 1 for routes only
+    int intraPairMinSpheres;                    // with intraPairThreads 0, least spheres every thread of one pair gets
+    bool convergenceBenchmark;                  // recording incumbent traces over seeds and thread counts instead of searching
+    int convergenceSeeds;                       // seeds every thread count of the convergence benchmark runs with
+    std::string convergenceThreads;             // comma separated thread counts of the convergence benchmark, 0 for all cpu cores
+    double convergenceOptimum;                  // known optimum RMSD the runs are compared with, -1 if unknown
+    double convergenceTarget;                   // time to target is measured for this fraction of the optimum (or best of all runs)
+    std::string convergenceFilename;            // JSON file the traces and statistics are written to
 
     void print() {
         if (!DEBUG) {
@@ -60,27 +95,138 @@ struct Config {
         }
         std::cout << "Config: " << std::endl;
         std::cout << " - " << "trajectoryFilename = " << trajectoryFilename << std::endl;
+        std::cout << " - " << "atomSelection = " << atomSelection << std::endl;
         std::cout << " - " << "matrixSize = " << matrixSize << std::endl;
+        std::cout << " - " << "frameFrom = " << frameFrom << std::endl;
         std::cout << " - " << "timeLimitMinutes = " << timeLimitMinutes << std::endl;
+        std::cout << " - " << "stopLatencyMs = " << stopLatencyMs << std::endl;
         std::cout << " - " << "showDebugCurrentBest = " << (showDebugCurrentBest ? "true" : "false") << std::endl;
         std::cout << " - " << "showDebugRouteBest = " << (showDebugRouteBest ? "true" : "false") << std::endl;
         std::cout << " - " << "jumpFromLocalAreaChance = " << jumpFromLocalAreaChance << std::endl;
         std::cout << " - " << "randomFrameWhileSwappingChance = " << randomFrameWhileSwappingChance << std::endl;
         std::cout << " - " << "randomSeed = " << (randomSeed ? "true" : "false") << std::endl;
         std::cout << " - " << "ompThreadsPerCore = " << ompThreadsPerCore << std::endl;
+        std::cout << " - " << "ompThreads = " << ompThreads << std::endl;
+        std::cout << " - " << "threadAffinity = " << threadAffinity << std::endl;
+        std::cout << " - " << "numaPlacement = " << numaPlacement << std::endl;
+        std::cout << " - " << "hugePages = " << hugePages << std::endl;
+        std::cout << " - " << "coordinatePrecision = " << coordinatePrecision << std::endl;
         std::cout << " - " << "memorySize = " << memorySize << std::endl;
         std::cout << " - " << "writeAsCSV = " << (writeAsCSV ? "true" : "false") << std::endl;
         std::cout << " - " << "showLogs = " << (showLogs ? "true" : "false") << std::endl;
         std::cout << " - " << "showRMSDCounter = " << (showRMSDCounter ? "true" : "false") << std::endl;
         std::cout << " - " << "runRepetitions = " << runRepetitions << std::endl;
+        std::cout << " - " << "topK = " << topK << std::endl;
+        std::cout << " - " << "topKMinSeparation = " << topKMinSeparation << std::endl;
+        std::cout << " - " << "sphereMap = " << (sphereMap ? "true" : "false") << std::endl;
+        std::cout << " - " << "sphereMapFilename = " << sphereMapFilename << std::endl;
+        std::cout << " - " << "writeAsJSON = " << (writeAsJSON ? "true" : "false") << std::endl;
+        std::cout << " - " << "searchStrategy = " << searchStrategy << std::endl;
+        std::cout << " - " << "annealingTemperature = " << annealingTemperature << std::endl;
+        std::cout << " - " << "annealingCooling = " << annealingCooling << std::endl;
+        std::cout << " - " << "tabuTenure = " << tabuTenure << std::endl;
+        std::cout << " - " << "tabuCandidates = " << tabuCandidates << std::endl;
+        std::cout << " - " << "tabuPatience = " << tabuPatience << std::endl;
+        std::cout << " - " << "coarseScreening = " << (coarseScreening ? "true" : "false") << std::endl;
+        std::cout << " - " << "coarseMargin = " << coarseMargin << std::endl;
+        std::cout << " - " << "coarseSpheres = " << coarseSpheres << std::endl;
+        std::cout << " - " << "fixedSizeKernels = " << (fixedSizeKernels ? "true" : "false") << std::endl;
+        std::cout << " - " << "benchmarkKernels = " << (benchmarkKernels ? "true" : "false") << std::endl;
+        std::cout << " - " << "sphereRadius = " << sphereRadius << std::endl;
+        std::cout << " - " << "sphereRadii = " << sphereRadii << std::endl;
+        std::cout << " - " << "verletSkin = " << verletSkin << std::endl;
+        std::cout << " - " << "fingerprintIndex = " << (fingerprintIndex ? "true" : "false") << std::endl;
+        std::cout << " - " << "fingerprintSeedChance = " << fingerprintSeedChance << std::endl;
+        std::cout << " - " << "fingerprintPairs = " << fingerprintPairs << std::endl;
+        std::cout << " - " << "residentCache = " << (residentCache ? "true" : "false") << std::endl;
+        std::cout << " - " << "cachePairs = " << cachePairs << std::endl;
+        std::cout << " - " << "cacheAllocations = " << cacheAllocations << std::endl;
+        std::cout << " - " << "serveSocket = " << serveSocket << std::endl;
+        std::cout << " - " << "serveThreads = " << serveThreads << std::endl;
+        std::cout << " - " << "streamLoad = " << (streamLoad ? "true" : "false") << std::endl;
+        std::cout << " - " << "follow = " << (follow ? "true" : "false") << std::endl;
+        std::cout << " - " << "followCapacity = " << followCapacity << std::endl;
+        std::cout << " - " << "followPollSeconds = " << followPollSeconds << std::endl;
+        std::cout << " - " << "followNewFramesChance = " << followNewFramesChance << std::endl;
+        std::cout << " - " << "autotune = " << (autotune ? "true" : "false") << std::endl;
+        std::cout << " - " << "autotuneSeeds = " << autotuneSeeds << std::endl;
+        std::cout << " - " << "autotuneFilename = " << autotuneFilename << std::endl;
+        std::cout << " - " << "intraPairThreads = " << intraPairThreads << std::endl;
+        std::cout << " - " << "intraPairMinSpheres = " << intraPairMinSpheres << std::endl;
+        std::cout << " - " << "convergenceBenchmark = " << (convergenceBenchmark ? "true" : "false") << std::endl;
+        std::cout << " - " << "convergenceSeeds = " << convergenceSeeds << std::endl;
+        std::cout << " - " << "convergenceThreads = " << convergenceThreads << std::endl;
+        std::cout << " - " << "convergenceOptimum = " << convergenceOptimum << std::endl;
+        std::cout << " - " << "convergenceTarget = " << convergenceTarget << std::endl;
+        std::cout << " - " << "convergenceFilename = " << convergenceFilename << std::endl;
     }
 
     void initDefault() {
         trajectoryFilename = "";
+        atomSelection = "all";
         timeLimitMinutes = 0.5;
+        stopLatencyMs = 1;
         ompThreadsPerCore = 0;
+        ompThreads = 0;
+        threadAffinity = "none";
+        numaPlacement = "none";
+        hugePages = "none";
+        coordinatePrecision = "double";
         writeAsCSV = false;
         runRepetitions = 1;
+        writeAsJSON = false;
+
+        searchStrategy = "localSearch";
+        annealingTemperature = 0.05;
+        annealingCooling = 0.95;
+        tabuTenure = 50;
+        tabuCandidates = 8;
+        tabuPatience = 10;
+
+        coarseScreening = false;
+        coarseMargin = 0.1;
+        coarseSpheres = 16;
+
+        fixedSizeKernels = true;
+        benchmarkKernels = false;
+        sphereRadius = 8;
+        sphereRadii = "";
+        verletSkin = 0;
+
+        fingerprintIndex = false;
+        fingerprintSeedChance = 0.5;
+        fingerprintPairs = 256;
+
+        residentCache = false;
+        cachePairs = 1000000;
+        cacheAllocations = 256;
+        serveSocket = "";
+        serveThreads = 0;
+
+        streamLoad = false;
+        follow = false;
+        followCapacity = 100000;
+        followPollSeconds = 1;
+        followNewFramesChance = 0.5;
+
+        autotune = false;
+        autotuneSeeds = 3;
+        autotuneFilename = "tuned_config.yml";
+
+        intraPairThreads = 0;
+        intraPairMinSpheres = 1000;
+
+        convergenceBenchmark = false;
+        convergenceSeeds = 5;
+        convergenceThreads = "1";
+        convergenceOptimum = -1;
+        convergenceTarget = 0.99;
+        convergenceFilename = "convergence.json";
+
+        topK = 1;
+        topKMinSeparation = 0;
+        sphereMap = false;
+        sphereMapFilename = "sphere_map.csv";
 
         jumpFromLocalAreaChance = 0.1;
         randomFrameWhileSwappingChance = 0.01;
@@ -88,6 +234,7 @@ struct Config {
 
         randomSeed = true;
         matrixSize = -1;
+        frameFrom = 0;
         showLogs = true;
         showRMSDCounter = false;
         showDebugCurrentBest = true;
@@ -95,24 +242,25 @@ struct Config {
     }
 };
 
-extern Config config;
-
 struct PairHash {
     template <typename T, typename U>
     std::size_t operator()(const std::pair<T, U>& p) const {
-        // Use std::hash for each element and combine the hashes
-        return std::hash<int>()(p.first) * config.matrixSize + std::hash<int>()(p.second);
+        // both frame numbers packed into one 64-bit key
+        return std::hash<long long>()(((long long)p.first << 32) | (unsigned)p.second);
     }
 };
 
-extern std::unordered_set<std::pair<int, int>, PairHash> memorySet;
-
-extern omp_lock_t memoryMutex;
+inline void seedRandom(unsigned seed) {
+    random_state = seed;
+}
 
-extern int MEMORY_SIZE;
+// number from [0, RAND_MAX] from the calling thread's generator, so threads never contend on rand()
+inline int nextRandom() {
+    return rand_r(&random_state);
+}
 
 inline extern int getRandom(int offset, int range) {
-    return offset + (rand() % (range + 1));
+    return offset + (nextRandom() % (range + 1));
 }
 
 template <class T> inline extern void _debug(T t) {
@@ -145,13 +293,13 @@ template <class T, class... Args> inline extern void debug(T t, Args... args) {
     }
 }
 
-inline extern void debugRMSD() {
+inline extern void debugRMSD(long count) {
     if (DEBUG_RMSD) {
         if (AlreadyShowedRMSDCalculationCount) {
             std::cout << "\r";
             std::cout.flush();
         }
-        std::cout << "[RMSD]: " << RMSDCalculationCount;
+        std::cout << "[RMSD]: " << count;
         AlreadyShowedRMSDCalculationCount = true;
     }
 }
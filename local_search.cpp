@@ -1,330 +1,98 @@
-#include <atomic>
-#include <chrono>
 #include <cstdlib>
 #include <cstring>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <omp.h>
 #include <stdexcept>
+#include <string>
+#include <tuple>
 
-#include "RMSD_calculation.h"
+#include "autotuner.h"
+#include "convergence_benchmark.h"
 #include "file_manager.h"
 #include "globals.h"
+#include "local_search.h"
+#include "local_search_api.h"
+#include "search_server.h"
+#include "search_strategy.h"
+
+// every setting a trajectory is read with (follow is rejected in batches), jobs with the same settings share one load
+static std::tuple<std::string, std::string, std::string, std::string, std::string, bool> loadSettings(const Config &config) {
+    return std::make_tuple(config.trajectoryFilename, config.atomSelection, config.coordinatePrecision, config.numaPlacement,
+                           config.hugePages, config.streamLoad);
+}
 
-bool DEBUG = true;
-bool DEBUG_RMSD = false;
-int RMSDCalculationCount = 0;
-int AllocationsCount = 0;
-bool AlreadyShowedRMSDCalculationCount = false;
-int omp_thread_id;
-
-double sphereRadius = 8;
-int SPHERES;
-int ATOMS;
-int FRAMES;
-int FRAMEONE;
-int FRAMETWO;
-
-// Atoms[<frame>][<atom>][<coordinate>]
-std::vector<std::vector<std::vector<double>>> A;
-
-// Maps sphere to CA; CAAtomNumber[<sphere>]
-std::vector<int> sphereCA;
-
-// List of atoms in [<sphere>]
-std::vector<std::vector<int>> *sphereAtoms;
-
-Config config;
-
-std::unordered_set<std::pair<int, int>, PairHash> memorySet;
-
-omp_lock_t memoryMutex;
-
-int MEMORY_SIZE;
-
-class LocalSearch {
-  public:
-    struct LocalSearchResult {
-        double rmsdValue;
-        int i;
-        int j;
-        LocalSearchResult() : rmsdValue(-1), i(-1), j(-1) {}
-        LocalSearchResult(double rmsdValue, int i, int j) : rmsdValue(rmsdValue), i(i), j(j) {}
-    };
-    LocalSearchResult bestResult;
-    RMSDCalculation rmsd;
-    std::chrono::time_point<std::chrono::steady_clock, std::chrono::nanoseconds> start;
-
-    LocalSearch() {
-        if (config.matrixSize == -1) {
-            config.matrixSize = FRAMES;
-        }
-    }
-
-    void choosePairRandom(int &i, int &j) {
-        i = getRandom(0, config.matrixSize - 1);
-        j = getRandom(0, config.matrixSize - 1);
-        while (i == j) {
-            j = getRandom(0, config.matrixSize - 1);
-        }
-    }
-
-    inline bool saveIfRouteBest(LocalSearchResult &routeBest, double value, int i, int j) {
-        if (value > routeBest.rmsdValue) {
-            routeBest = {
-                value,
-                i,
-                j,
-            };
-            if (config.showDebugRouteBest) {
-                debug("[Current route best]: [", i, ", ", j, "] = ", value);
-            }
-            return true;
-        }
-        return false;
-    }
-
-    inline void saveIfBest(double value, int i, int j) {
-        if (value > bestResult.rmsdValue) {
-            bestResult = {
-                value,
-                i,
-                j,
-            };
-            bestResult.j = j;
-            bestResult.rmsdValue = value;
-            if (config.showDebugCurrentBest) {
-                debug("[Current best]: [", i, ", ", j, "] = ", value);
-            }
-        }
+// frames a load read in the background had no room for, reported once the searches on it are over; 1 if any
+static int droppedFramesError(const Trajectory &trajectory, const std::string &filename) {
+    if (trajectory.framesDropped == 0) {
+        return 0;
     }
+    std::cout << "Load error: " << trajectory.framesDropped << " frames of " << filename << " were not read, coordinates had room for "
+              << trajectory.A.size() << " frames" << std::endl;
+    return 1;
+}
 
-    inline bool insideMatrixBoundaries(int &i) {
-        return i >= 0 && i < config.matrixSize;
+// running batch jobs on one pool of threads, every trajectory is read only once for every set of load settings
+int runBatch(std::vector<Config> &jobs, int threads, SearchContext &context) {
+    if (threads <= 0) {
+        threads = omp_get_num_procs();
     }
-
-    inline double changeAllocationsAndCalculate(int &allocatedOnFrame, int &changingFrame) {
-        if (getRandom(1, 100) <= config.randomFrameWhileSwappingChance * 100) {
-            // (A, B) -> (C, D)
-            int new_i = getRandom(0, config.matrixSize - 1);
-            int new_j = getRandom(0, config.matrixSize - 1);
-            while (new_i == allocatedOnFrame || new_i == changingFrame) {
-                new_i = getRandom(0, config.matrixSize - 1);
-            }
-            while (new_j == allocatedOnFrame || new_j == changingFrame || new_j == new_i) {
-                new_j = getRandom(0, config.matrixSize - 1);
-            }
-            allocatedOnFrame = new_i;
-            changingFrame = new_j;
-            rmsd.atomsAllocation(allocatedOnFrame);
-
-            return rmsd.calculateRMSDSuperpose(changingFrame);
+    std::stable_sort(jobs.begin(), jobs.end(), [](const Config &a, const Config &b) {
+        return loadSettings(a) < loadSettings(b);
+    });
+
+    int loadErrors = 0;
+    size_t groupStart = 0;
+    while (groupStart < jobs.size()) {
+        size_t groupEnd = groupStart;
+        while (groupEnd < jobs.size() && loadSettings(jobs[groupEnd]) == loadSettings(jobs[groupStart])) {
+            groupEnd++;
         }
-        // (A, B) -> (B, C)
-        int new_j = getRandom(0, config.matrixSize - 1);
-        while (new_j == allocatedOnFrame || new_j == changingFrame) {
-            new_j = getRandom(0, config.matrixSize - 1);
+        int result = context.load(jobs[groupStart]);
+        if (result != 0) {
+            return result;
         }
-        allocatedOnFrame = changingFrame;
-        changingFrame = new_j;
-        rmsd.atomsAllocation(allocatedOnFrame);
-        return rmsd.calculateRMSDSuperpose(changingFrame);
-    }
-
-    bool jump(int &allocatedOnFrame, int &changingFrame, LocalSearchResult &routeBest) {
-        int new_j = getRandom(0, config.matrixSize - 1);
-
-        while (new_j == allocatedOnFrame || new_j == changingFrame) {
-            new_j = getRandom(0, config.matrixSize - 1);
-        }
-
-        double newValue = rmsd.calculateRMSDSuperpose(new_j);
+        std::shared_ptr<const Trajectory> trajectory = context.trajectory();
+        debug("[Batch] [Runs]: ", groupEnd - groupStart, " [Threads]: ", threads);
 
-        if (saveIfRouteBest(routeBest, newValue, allocatedOnFrame, new_j)) {
-            changingFrame = new_j;
-            return true;
+#pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+        for (size_t job = groupStart; job < groupEnd; job++) {
+            omp_thread_id = omp_get_thread_num();
+            omp_numa_node = numaTopology().pinCurrentThread(jobs[job].threadAffinity, omp_thread_id);
+            Config jobConfig = jobs[job];
+            jobConfig.showDebugCurrentBest = false;
+            jobConfig.showDebugRouteBest = false;
+            LocalSearch localSearch(*trajectory, jobConfig, context.fingerprintIndex(jobConfig), context.residentCache(jobConfig));
+            localSearch.runOnCurrentThread();
         }
-        return false;
-    }
+        loadErrors += droppedFramesError(*trajectory, jobs[groupStart].trajectoryFilename);
 
-    inline bool identifiersGood(int &i, int &j) {
-        return insideMatrixBoundaries(j) && i != j;
+        groupStart = groupEnd;
     }
+    return loadErrors > 0 ? 1 : 0;
+}
 
-    LocalSearchResult traverse(int i, int j) {
-        // traversing route: i != j checked
-        int allocatedOnFrame = i;
-        int changingFrame = j;
-        rmsd.atomsAllocation(allocatedOnFrame);
-        LocalSearchResult routeBest = {
-            rmsd.calculateRMSDSuperpose(changingFrame),
-            allocatedOnFrame,
-            changingFrame,
-        };
-
-        bool changedSidesAlready = false;
-        int step = getRandom(0, 1) * 2 - 1; // -1 or +1
-
-        while (true) {
-            auto stop = std::chrono::steady_clock::now();
-            std::chrono::duration<double> elapsed = stop - start;
-            if (elapsed.count() > config.timeLimitMinutes * 60) {
-                return routeBest;
-            }
-
-            int newChangingFrame = changingFrame + step;
-            if (!identifiersGood(allocatedOnFrame, newChangingFrame)) {
-                // changing direction
-                if (!changedSidesAlready) {
-                    step *= -1;
-                    changedSidesAlready = true;
-                    continue;
-                }
-                step = getRandom(0, 1) * 2 - 1; // -1 or +1
-                changedSidesAlready = false;
-                // otherwise, try to jump
-                if (getRandom(1, 100) <= config.jumpFromLocalAreaChance * 100 && jump(allocatedOnFrame, changingFrame, routeBest)) {
-                    // jump
-                    continue;
-                }
-                // otherwise, no jump, change allocations
-                double newValue = changeAllocationsAndCalculate(allocatedOnFrame, changingFrame);
-
-                if (saveIfRouteBest(routeBest, newValue, allocatedOnFrame, changingFrame)) {
-                    continue;
-                } else {
-                    return routeBest;
-                }
-            }
-
-            double newValue = rmsd.calculateRMSDSuperpose(newChangingFrame);
-            if (saveIfRouteBest(routeBest, newValue, allocatedOnFrame, newChangingFrame)) {
-                // better than current best
-                // going in straight line from now on
-                changingFrame = newChangingFrame;
-                while (true) {
-                    newChangingFrame = changingFrame + step;
-                    if (!identifiersGood(allocatedOnFrame, newChangingFrame)) {
-                        break;
-                    }
-                    newValue = rmsd.calculateRMSDSuperpose(newChangingFrame);
-
-                    if (saveIfRouteBest(routeBest, newValue, allocatedOnFrame, newChangingFrame)) {
-                        changingFrame = newChangingFrame;
-                        continue;
-                    } else {
-                        break;
-                    }
-                }
-                // cannot go straight line anymore
-                // cannot change direction because we came from there
-                // trying to jump
-                step = getRandom(0, 1) * 2 - 1; // -1 or +1
-                changedSidesAlready = false;
-                if (getRandom(1, 100) <= config.jumpFromLocalAreaChance * 100 && jump(allocatedOnFrame, changingFrame, routeBest)) {
-                    // jump
-                    continue;
-                }
-                // otherwise, no jump, change allocations
-                double newValue = changeAllocationsAndCalculate(allocatedOnFrame, changingFrame);
-
-                if (saveIfRouteBest(routeBest, newValue, allocatedOnFrame, changingFrame)) {
-                    continue;
-                } else {
-                    return routeBest;
-                }
-            }
-
-            // not better
-            // trying to change sides
-            if (!changedSidesAlready) {
-                step *= -1;
-                changedSidesAlready = true;
-                continue;
-            }
-
-            // cannot change directions
-            step = getRandom(0, 1) * 2 - 1; // -1 or +1
-            changedSidesAlready = false;
-            // otherwise, try to jump
-            if (getRandom(1, 100) <= config.jumpFromLocalAreaChance * 100 && jump(allocatedOnFrame, changingFrame, routeBest)) {
-                // jump
-                continue;
-            }
-            // otherwise, no jump, change allocations
-            newValue = changeAllocationsAndCalculate(allocatedOnFrame, changingFrame);
-
-            if (saveIfRouteBest(routeBest, newValue, allocatedOnFrame, changingFrame)) {
-                continue;
-            } else {
-                return routeBest;
-            }
-        }
+// tuning parameters for config.timeLimitMinutes and writing them to config.autotuneFilename
+int runAutotune(const Config &config, SearchContext &context) {
+    Autotuner tuner(config, context);
+    std::vector<Autotuner::Candidate> ranked = tuner.tune();
+    print("Autotune Results:");
+    for (size_t c = 0; c < ranked.size(); c++) {
+        const Autotuner::Candidate &candidate = ranked[c];
+        print(" - jumpFromLocalAreaChance: ", candidate.jumpChance, ", randomFrameWhileSwappingChance: ", candidate.randomFrameChance,
+              ", memorySize: ", candidate.memorySize, " -> mean best ", candidate.meanBest, " (time to best ", candidate.meanTimeToBest,
+              "s, ", candidate.rounds, " rounds)");
     }
-
-    void run() {
-        omp_set_num_threads(omp_get_num_procs() * config.ompThreadsPerCore);
-        int AllocationsCountGlobal = 0;
-        int RMSDCalculationCountGlobal = 0;
-
-        start = std::chrono::steady_clock::now();
-        std::atomic<bool> time_exceeded(false);
-
-#pragma omp parallel
-        {
-            omp_thread_id = omp_get_thread_num();
-            if (omp_thread_id == 0) {
-                debug("[OMP] [Number of threads]: ", omp_get_num_threads());
-                sphereAtoms = new std::vector<std::vector<int>>[omp_get_num_threads()];
-            }
-
-#pragma omp barrier
-
-            while (!time_exceeded) {
-                // one route
-                int i, j;
-                choosePairRandom(i, j);
-
-                LocalSearchResult routeBest = traverse(i, j);
-                saveIfBest(routeBest.rmsdValue, routeBest.i, routeBest.j);
-
-                if (omp_thread_id == 0) {
-                    auto stop = std::chrono::steady_clock::now();
-                    std::chrono::duration<double> elapsed = stop - start;
-                    if (elapsed.count() > config.timeLimitMinutes * 60) {
-                        time_exceeded.store(true, std::memory_order_relaxed);
-                        break;
-                    }
-                }
-            }
-#pragma omp atomic
-            RMSDCalculationCountGlobal += RMSDCalculationCount;
-#pragma omp atomic
-            AllocationsCountGlobal += AllocationsCount;
-        }
-
-        delete[] sphereAtoms;
-
-        auto stop = std::chrono::steady_clock::now();
-        std::chrono::duration<double> elapsed = stop - start;
-        print("Local Search Results:");
-        print(" - Computation time: ", elapsed.count(), "s");
-        print(" - RMSD counted: ", RMSDCalculationCountGlobal, " times.");
-        print(" - Atoms allocated: ", AllocationsCountGlobal, " times.");
-
-        if (config.writeAsCSV) {
-            FileManager::writeResultsAsCSV(bestResult.i, bestResult.j, bestResult.rmsdValue, elapsed.count());
-        }
-
-        return;
+    if (!Autotuner::writeTunedConfig(config, *context.trajectory(), ranked, tuner.trialThreads())) {
+        return 1;
     }
-};
+    print(" - Tuned config: ", config.autotuneFilename);
+    return 0;
+}
 
 void resetGlobals() {
-    RMSDCalculationCount = 0;
-    AllocationsCount = 0;
     AlreadyShowedRMSDCalculationCount = false;
-    memorySet.clear();
 }
 
 // Function to parse a value of type T from a string
@@ -350,7 +118,7 @@ bool parseBoolean(const std::string &str) {
     }
 }
 
-int readArgs(int argc, char *argv[], FileManager &fileManager) {
+int readArgs(int argc, char *argv[], FileManager &fileManager, Config &config, std::string &batchFilename) {
 
     if (argc == 1) {
         std::cout << "local_search: too few arguments" << std::endl;
@@ -364,19 +132,71 @@ int readArgs(int argc, char *argv[], FileManager &fileManager) {
         std::cout << std::endl;
         std::cout << "Options:" << std::endl;
         std::cout << "  -c CONFIG                           provide config parameters via CONFIG file" << std::endl;
+        std::cout << "  -b BATCH                            run configs and parameter sweeps listed in BATCH file concurrently" << std::endl;
         std::cout << "  -h, --help                          display this message and exit" << std::endl;
         std::cout << std::endl;
         std::cout << "Parameters if no config provided. In descriptions: [type:default] format is used," << std::endl;
         std::cout << "where type is the type of parameter, and default is its default value." << std::endl;
         std::cout << "  --trajectory=TRAJECTORY             [string:] [mandatory] trajectory filename in .pdb format" << std::endl;
+        std::cout << "  --select=SELECTION                  [string:all] atoms kept at load, e.g. backbone, heavy, \"resid 10-50 and chain A\"" << std::endl;
         std::cout << "  --time-limit=TIME                   [double:1.0] max time in minutes for whole local search to finish" << std::endl;
+        std::cout << "  --stop-latency=MS                   [double:1] target delay of stopping after the time limit" << std::endl;
         std::cout << "  --omp-threads=NUM                   [double:0] omp threads number per one cpu core" << std::endl;
+        std::cout << "  --threads=NUM                       [int:0] omp threads number, overrides --omp-threads if > 0" << std::endl;
+        std::cout << "  --thread-affinity=MODE              [string:none] pin threads: none, compact or spread over NUMA nodes" << std::endl;
+        std::cout << "  --numa-placement=MODE               [string:none] coordinates placement: none, interleave or replicate per NUMA node" << std::endl;
+        std::cout << "  --huge-pages=MODE                   [string:none] coordinates backed by huge pages: none, transparent or explicit" << std::endl;
+        std::cout << "  --coordinate-precision=MODE         [string:double] stored coordinates: double or int16 (a quarter of the memory)" << std::endl;
         std::cout << "  --write-as-csv=[true/false]         [bool:false] each run of a program generates one line in CSV format" << std::endl;
+        std::cout << "  --write-as-json=[true/false]        [bool:false] each run of a program generates one line in JSON format" << std::endl;
         std::cout << "  --repetitions=REPS                  [int:2] number of program executions" << std::endl;
 
         std::cout << "  --jump-chance=PROB                  [double:0.1] probability of jumping from local area" << std::endl;
         std::cout << "  --random-frame-chance=PROB          [double:0.01] probability of choosing random frame while swapping allocations" << std::endl;
         std::cout << "  --memory-size=SIZE                  [double:0.1] [0, 1] where 0 is no memory, and 1 is remembering whole matrix" << std::endl;
+        std::cout << "  --strategy=NAME                     [string:localSearch] search strategy: localSearch, annealing, tabu or portfolio" << std::endl;
+        std::cout << "  --annealing-temperature=FRAC        [double:0.05] starting temperature as a fraction of route starting value" << std::endl;
+        std::cout << "  --annealing-cooling=RATE            [double:0.95] temperature multiplier after every annealing move" << std::endl;
+        std::cout << "  --tabu-tenure=ITERS                 [int:50] number of iterations a visited pair stays tabu" << std::endl;
+        std::cout << "  --tabu-candidates=NUM               [int:8] neighbours evaluated in every tabu iteration" << std::endl;
+        std::cout << "  --tabu-patience=ITERS               [int:10] tabu iterations without improvement ending a route" << std::endl;
+        std::cout << "  --coarse-screening=[true/false]     [bool:false] fully evaluate only pairs with promising coarse CA-only score" << std::endl;
+        std::cout << "  --coarse-margin=FRAC                [double:0.1] how far below the value to beat a coarse score may be" << std::endl;
+        std::cout << "  --coarse-spheres=NUM                [int:16] number of representative spheres in coarse score, 0 means all" << std::endl;
+        std::cout << "  --fixed-size-kernels=[true/false]   [bool:true] calculate spheres up to 256 atoms with compile-time sized kernels" << std::endl;
+        std::cout << "  --benchmark-kernels=[true/false]    [bool:false] benchmark fixed size kernels against the dynamic path instead of searching" << std::endl;
+        std::cout << "  --sphere-radius=ANGSTROMS           [double:8] atoms within this distance from a CA form its sphere" << std::endl;
+        std::cout << "  --sphere-radii=LIST                 [string:] comma separated radii scored together with --sphere-radius in one pass" << std::endl;
+        std::cout << "  --verlet-skin=ANGSTROMS             [double:0] neighbour list margin beyond sphere radius, 0 to disable" << std::endl;
+        std::cout << "  --fingerprint-index=[true/false]    [bool:false] seed routes and jumps from frame fingerprint index" << std::endl;
+        std::cout << "  --fingerprint-seed-chance=PROB      [double:0.5] probability of taking starting pair or jump target from the index" << std::endl;
+        std::cout << "  --fingerprint-pairs=NUM             [int:256] number of the most distant fingerprint pairs kept in the index" << std::endl;
+        std::cout << "  --frame-from=FRAME                  [int:0] first analysed frame, frames from FRAME to FRAME + matrix size - 1" << std::endl;
+        std::cout << "  --resident-cache=[true/false]       [bool:false] keep pair values and allocations for later searches (repetitions, batch, serve)" << std::endl;
+        std::cout << "  --cache-pairs=NUM                   [int:1000000] max number of pair values in resident cache" << std::endl;
+        std::cout << "  --cache-allocations=NUM             [int:256] max number of frame allocations in resident cache" << std::endl;
+        std::cout << "  --serve=SOCKET                      [string:] serve search requests on Unix socket SOCKET instead of searching" << std::endl;
+        std::cout << "  --serve-threads=NUM                 [int:0] threads shared by all served searches, 0 means all cpu cores" << std::endl;
+        std::cout << "  --stream-load=[true/false]          [bool:false] start searching while the trajectory is still being read" << std::endl;
+        std::cout << "  --follow=[true/false]               [bool:false] tail trajectory file which is still being written, searching new frames as they come" << std::endl;
+        std::cout << "  --follow-capacity=FRAMES            [int:100000] max number of frames kept while following" << std::endl;
+        std::cout << "  --follow-poll=SECONDS               [double:1] how long to wait for new frames at the end of file" << std::endl;
+        std::cout << "  --follow-new-frames-chance=PROB     [double:0.5] probability of starting a route at a pair with one of the newest frames" << std::endl;
+        std::cout << "  --autotune=[true/false]             [bool:false] tune jump, random frame and memory parameters for the time limit instead of searching" << std::endl;
+        std::cout << "  --autotune-seeds=NUM                [int:3] seeds every candidate is tried with in every round" << std::endl;
+        std::cout << "  --autotune-file=FILE                [string:tuned_config.yml] config file the tuned parameters are written to" << std::endl;
+        std::cout << "  --intra-pair-threads=NUM            [int:0] threads calculating spheres of one pair, 0 to choose from system size, 1 for routes only" << std::endl;
+        std::cout << "  --intra-pair-min-spheres=NUM        [int:1000] with --intra-pair-threads=0, least spheres every thread of one pair gets" << std::endl;
+        std::cout << "  --convergence=[true/false]          [bool:false] record incumbent traces over seeds and thread counts instead of searching" << std::endl;
+        std::cout << "  --convergence-seeds=NUM             [int:5] seeds every thread count runs with" << std::endl;
+        std::cout << "  --convergence-threads=LIST          [string:1] comma separated thread counts, 0 for all cpu cores" << std::endl;
+        std::cout << "  --convergence-optimum=RMSD          [double:-1] known optimum the runs are compared with, -1 if unknown" << std::endl;
+        std::cout << "  --convergence-target=FRACTION       [double:0.99] time to target is measured for this fraction of the optimum" << std::endl;
+        std::cout << "  --convergence-file=FILE             [string:convergence.json] JSON file the traces and statistics are written to" << std::endl;
+        std::cout << "  --top-k=K                           [int:1] number of the most deviating pairs to report" << std::endl;
+        std::cout << "  --top-k-separation=FRAMES           [int:0] min frame distance between reported pairs, 0 to disable" << std::endl;
+        std::cout << "  --sphere-map=[true/false]           [bool:false] write per-sphere RMSD of the top pairs and per-sphere maxima" << std::endl;
+        std::cout << "  --sphere-map-file=FILE              [string:sphere_map.csv] CSV file the sphere map is written to" << std::endl;
 
         std::cout << "  --random-seed=[true/false]          [bool:true] random seed for srand()" << std::endl;
         std::cout << "  --matrix-size=SIZE                  [int:-1] limiting matrix to SIZE by SIZE, if -1 then SIZE is max for current trajectory file"
@@ -388,6 +208,8 @@ int readArgs(int argc, char *argv[], FileManager &fileManager) {
         std::cout << std::endl;
         std::cout << "Examples:" << std::endl;
         std::cout << "  local_search -c config.yml" << std::endl;
+        std::cout << "  local_search -b batch.yml" << std::endl;
+        std::cout << "  local_search --serve=/tmp/local_search.sock --serve-threads=16" << std::endl;
         std::cout << "  local_search --trajectory=traj.pdb --time-limit=0.5 --repetitions=5" << std::endl;
         std::cout << std::endl;
         std::cout << "All bool possible values:" << std::endl;
@@ -395,10 +217,21 @@ int readArgs(int argc, char *argv[], FileManager &fileManager) {
         std::cout << "  maps to false: [false] [f] [0] [no]  [n] [off]" << std::endl;
         return 1;
 
+    } else if (argc == 3 && strcmp(argv[1], "-b") == 0) {
+        batchFilename = std::string(argv[2]);
+        return 0;
     } else if (argc == 3 && strcmp(argv[1], "-c") == 0) {
         std::string configFilename = std::string(argv[2]);
 
-        if (!fileManager.readConfig(configFilename)) {
+        if (!fileManager.readConfig(configFilename, config)) {
+            return 1;
+        }
+        if (!strategyNameValid(config.searchStrategy)) {
+            std::cout << "Unknown search strategy: " << config.searchStrategy << std::endl;
+            return 1;
+        }
+        if (!sphereRadiiError(config).empty()) {
+            std::cout << sphereRadiiError(config) << std::endl;
             return 1;
         }
         return 0;
@@ -423,14 +256,20 @@ int readArgs(int argc, char *argv[], FileManager &fileManager) {
 
         if (argMap.count("trajectory")) {
             config.trajectoryFilename = argMap["trajectory"];
-        } else {
+        } else if (!argMap.count("serve")) {
             std::cout << "Trajectory file is mandatory." << std::endl;
             std::cout << "Try 'local_search --help' for more information." << std::endl;
             return 1;
         }
+        if (argMap.count("select")) {
+            config.atomSelection = argMap["select"];
+        }
         if (argMap.count("time-limit")) {
             config.timeLimitMinutes = parseValue<double>(argMap["time-limit"]);
         }
+        if (argMap.count("stop-latency")) {
+            config.stopLatencyMs = parseValue<double>(argMap["stop-latency"]);
+        }
         if (argMap.count("omp-threads")) {
             config.ompThreadsPerCore = parseValue<double>(argMap["omp-threads"]);
         }
@@ -467,10 +306,166 @@ int readArgs(int argc, char *argv[], FileManager &fileManager) {
         if (argMap.count("show-route-best")) {
             config.showDebugRouteBest = parseBoolean(argMap["show-route-best"]);
         }
+        if (argMap.count("strategy")) {
+            config.searchStrategy = argMap["strategy"];
+        }
+        if (argMap.count("annealing-temperature")) {
+            config.annealingTemperature = parseValue<double>(argMap["annealing-temperature"]);
+        }
+        if (argMap.count("annealing-cooling")) {
+            config.annealingCooling = parseValue<double>(argMap["annealing-cooling"]);
+        }
+        if (argMap.count("tabu-tenure")) {
+            config.tabuTenure = parseValue<int>(argMap["tabu-tenure"]);
+        }
+        if (argMap.count("tabu-candidates")) {
+            config.tabuCandidates = parseValue<int>(argMap["tabu-candidates"]);
+        }
+        if (argMap.count("tabu-patience")) {
+            config.tabuPatience = parseValue<int>(argMap["tabu-patience"]);
+        }
+        if (argMap.count("coarse-screening")) {
+            config.coarseScreening = parseBoolean(argMap["coarse-screening"]);
+        }
+        if (argMap.count("coarse-margin")) {
+            config.coarseMargin = parseValue<double>(argMap["coarse-margin"]);
+        }
+        if (argMap.count("coarse-spheres")) {
+            config.coarseSpheres = parseValue<int>(argMap["coarse-spheres"]);
+        }
+        if (argMap.count("threads")) {
+            config.ompThreads = parseValue<int>(argMap["threads"]);
+        }
+        if (argMap.count("thread-affinity")) {
+            config.threadAffinity = argMap["thread-affinity"];
+        }
+        if (argMap.count("numa-placement")) {
+            config.numaPlacement = argMap["numa-placement"];
+        }
+        if (argMap.count("huge-pages")) {
+            config.hugePages = argMap["huge-pages"];
+        }
+        if (argMap.count("coordinate-precision")) {
+            config.coordinatePrecision = argMap["coordinate-precision"];
+        }
+        if (argMap.count("fixed-size-kernels")) {
+            config.fixedSizeKernels = parseBoolean(argMap["fixed-size-kernels"]);
+        }
+        if (argMap.count("benchmark-kernels")) {
+            config.benchmarkKernels = parseBoolean(argMap["benchmark-kernels"]);
+        }
+        if (argMap.count("sphere-radius")) {
+            config.sphereRadius = parseValue<double>(argMap["sphere-radius"]);
+        }
+        if (argMap.count("sphere-radii")) {
+            config.sphereRadii = argMap["sphere-radii"];
+        }
+        if (argMap.count("verlet-skin")) {
+            config.verletSkin = parseValue<double>(argMap["verlet-skin"]);
+        }
+        if (argMap.count("fingerprint-index")) {
+            config.fingerprintIndex = parseBoolean(argMap["fingerprint-index"]);
+        }
+        if (argMap.count("fingerprint-seed-chance")) {
+            config.fingerprintSeedChance = parseValue<double>(argMap["fingerprint-seed-chance"]);
+        }
+        if (argMap.count("fingerprint-pairs")) {
+            config.fingerprintPairs = parseValue<int>(argMap["fingerprint-pairs"]);
+        }
+        if (argMap.count("frame-from")) {
+            config.frameFrom = parseValue<int>(argMap["frame-from"]);
+        }
+        if (argMap.count("resident-cache")) {
+            config.residentCache = parseBoolean(argMap["resident-cache"]);
+        }
+        if (argMap.count("cache-pairs")) {
+            config.cachePairs = parseValue<int>(argMap["cache-pairs"]);
+        }
+        if (argMap.count("cache-allocations")) {
+            config.cacheAllocations = parseValue<int>(argMap["cache-allocations"]);
+        }
+        if (argMap.count("serve")) {
+            config.serveSocket = argMap["serve"];
+        }
+        if (argMap.count("serve-threads")) {
+            config.serveThreads = parseValue<int>(argMap["serve-threads"]);
+        }
+        if (argMap.count("stream-load")) {
+            config.streamLoad = parseBoolean(argMap["stream-load"]);
+        }
+        if (argMap.count("follow")) {
+            config.follow = parseBoolean(argMap["follow"]);
+        }
+        if (argMap.count("follow-capacity")) {
+            config.followCapacity = parseValue<int>(argMap["follow-capacity"]);
+        }
+        if (argMap.count("follow-poll")) {
+            config.followPollSeconds = parseValue<double>(argMap["follow-poll"]);
+        }
+        if (argMap.count("follow-new-frames-chance")) {
+            config.followNewFramesChance = parseValue<double>(argMap["follow-new-frames-chance"]);
+        }
+        if (argMap.count("autotune")) {
+            config.autotune = parseBoolean(argMap["autotune"]);
+        }
+        if (argMap.count("autotune-seeds")) {
+            config.autotuneSeeds = parseValue<int>(argMap["autotune-seeds"]);
+        }
+        if (argMap.count("autotune-file")) {
+            config.autotuneFilename = argMap["autotune-file"];
+        }
+        if (argMap.count("intra-pair-threads")) {
+            config.intraPairThreads = parseValue<int>(argMap["intra-pair-threads"]);
+        }
+        if (argMap.count("intra-pair-min-spheres")) {
+            config.intraPairMinSpheres = parseValue<int>(argMap["intra-pair-min-spheres"]);
+        }
+        if (argMap.count("convergence")) {
+            config.convergenceBenchmark = parseBoolean(argMap["convergence"]);
+        }
+        if (argMap.count("convergence-seeds")) {
+            config.convergenceSeeds = parseValue<int>(argMap["convergence-seeds"]);
+        }
+        if (argMap.count("convergence-threads")) {
+            config.convergenceThreads = argMap["convergence-threads"];
+        }
+        if (argMap.count("convergence-optimum")) {
+            config.convergenceOptimum = parseValue<double>(argMap["convergence-optimum"]);
+        }
+        if (argMap.count("convergence-target")) {
+            config.convergenceTarget = parseValue<double>(argMap["convergence-target"]);
+        }
+        if (argMap.count("convergence-file")) {
+            config.convergenceFilename = argMap["convergence-file"];
+        }
+        if (argMap.count("top-k")) {
+            config.topK = parseValue<int>(argMap["top-k"]);
+        }
+        if (argMap.count("top-k-separation")) {
+            config.topKMinSeparation = parseValue<int>(argMap["top-k-separation"]);
+        }
+        if (argMap.count("sphere-map")) {
+            config.sphereMap = parseBoolean(argMap["sphere-map"]);
+        }
+        if (argMap.count("sphere-map-file")) {
+            config.sphereMapFilename = argMap["sphere-map-file"];
+        }
+        if (argMap.count("write-as-json")) {
+            config.writeAsJSON = parseBoolean(argMap["write-as-json"]);
+        }
 
         DEBUG = config.showLogs;
         DEBUG_RMSD = config.showRMSDCounter;
 
+        if (!strategyNameValid(config.searchStrategy)) {
+            std::cout << "Unknown search strategy: " << config.searchStrategy << std::endl;
+            return 1;
+        }
+        if (!sphereRadiiError(config).empty()) {
+            std::cout << sphereRadiiError(config) << std::endl;
+            return 1;
+        }
+
         if (DEBUG) {
             for (const auto &kv : argMap) {
                 std::cout << "(arg) [" << kv.first << "]: [" << kv.second << "]" << std::endl;
@@ -484,19 +479,73 @@ int readArgs(int argc, char *argv[], FileManager &fileManager) {
 
 int main(int argc, char *argv[]) {
 
-    omp_init_lock(&memoryMutex);
     FileManager fileManager;
-    int result = readArgs(argc, argv, fileManager);
+    Config config;
+    std::string batchFilename;
+    int result = readArgs(argc, argv, fileManager, config, batchFilename);
     if (result != 0) {
         return result;
     }
 
-    result = fileManager.readTrajectory();
+    if (!config.serveSocket.empty()) {
+        if (config.randomSeed) {
+            srand((unsigned)time(NULL));
+        }
+        SearchServer server(config);
+        return server.run();
+    }
+
+    SearchContext context;
+    if (!batchFilename.empty()) {
+        std::vector<Config> jobs;
+        int threads;
+        if (!fileManager.readBatch(batchFilename, jobs, threads)) {
+            return 1;
+        }
+        for (const Config &job : jobs) {
+            if (!strategyNameValid(job.searchStrategy)) {
+                std::cout << "Unknown search strategy: " << job.searchStrategy << std::endl;
+                return 1;
+            }
+            if (!sphereRadiiError(job).empty()) {
+                std::cout << sphereRadiiError(job) << std::endl;
+                return 1;
+            }
+            // a followed trajectory never ends, so its group would never finish
+            if (job.follow) {
+                std::cout << "Follow mode cannot be used in a batch: " << job.trajectoryFilename << std::endl;
+                return 1;
+            }
+        }
+        if (jobs.empty() || jobs[0].randomSeed) {
+            srand((unsigned)time(NULL));
+        } else {
+            srand((unsigned)NULL);
+        }
+        return runBatch(jobs, threads, context);
+    }
+
+    if (config.autotune || config.convergenceBenchmark) {
+        // trials compare runs on the same, complete trajectory
+        config.streamLoad = false;
+        config.follow = false;
+    }
+    result = context.load(config);
     if (result != 0) {
         return result;
     }
 
-    MEMORY_SIZE = config.matrixSize * config.matrixSize * config.memorySize;
+    if (config.benchmarkKernels) {
+        omp_thread_id = 0;
+        RMSDCalculation rmsd(*context.trajectory());
+        // spheres of the configured radius, as a search allocates them; radii were validated above
+        std::vector<double> radii;
+        RMSDCalculation::parseRadii(config.sphereRadii, config.sphereRadius, radii);
+        rmsd.setRadii(config.sphereRadius, radii);
+        rmsd.initThreads(1, 0);
+        rmsd.benchmarkKernels(100);
+        return 0;
+    }
 
     if (config.randomSeed) {
         srand((unsigned)time(NULL));
@@ -504,14 +553,26 @@ int main(int argc, char *argv[]) {
         srand((unsigned)NULL);
     }
 
+    if (config.autotune) {
+        return runAutotune(config, context);
+    }
+    if (config.convergenceBenchmark) {
+        ConvergenceBenchmark benchmark(config, context);
+        benchmark.run();
+        benchmark.print();
+        if (!benchmark.write()) {
+            return 1;
+        }
+        print(" - Traces: ", config.convergenceFilename);
+        return 0;
+    }
+
     for (int i = 0; i < config.runRepetitions; i++) {
-        LocalSearch localSearch;
         resetGlobals();
         if (i == 0) {
             config.print();
         }
-        localSearch.run();
+        context.search(config);
     }
-
-    omp_destroy_lock(&memoryMutex);
+    return droppedFramesError(*context.trajectory(), config.trajectoryFilename);
 }
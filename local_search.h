@@ -0,0 +1,399 @@
+#ifndef LOCAL_SEARCH_H
+#define LOCAL_SEARCH_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <vector>
+#include <omp.h>
+
+#include "deadline_token.h"
+#include "evaluator.h"
+#include "file_manager.h"
+#include "globals.h"
+#include "search_strategy.h"
+#include "sphere_map.h"
+#include "top_k.h"
+#include "trajectory.h"
+
+// results and counters of one search, also available while it runs
+struct SearchStats {
+    LocalSearchResult best;
+    std::vector<TopKPairs::Entry> topPairs;
+    double elapsedSeconds;
+    double timeToBest;
+    // since the start of trajectory loading, which may overlap with the search
+    double timeToFirstResult;
+    // 0 while the trajectory is still being read
+    double loadSeconds;
+    // frames of the file not loaded, coordinates had no room for them; a load error
+    int framesDropped;
+    long rmsdCalculations;
+    long allocations;
+    long screened;
+    // resident cache lookups and hits, of pair values and of allocations
+    long valueLookups;
+    long valueHits;
+    long allocationLookups;
+    long allocationHits;
+    int threads;
+    // threads of the nested team calculating one pair, 1 if only routes run in parallel
+    int pairThreads;
+    // frames in the matrix, grows while following a trajectory
+    int frames;
+    bool running;
+    // how late the last thread stopped after the time limit, 0 if cancelled before it
+    double stopLatency;
+    // filled once the search is over, if config.sphereMap is set
+    SphereMap sphereMap;
+    // incumbent improvements, filled once the search is over
+    std::vector<IncumbentPoint> trace;
+    // with config.sphereRadii, every radius and the best evaluated pair for it, filled once the search is over
+    std::vector<double> radii;
+    std::vector<LocalSearchResult> radiusBest;
+
+    SearchStats()
+        : elapsedSeconds(0), timeToBest(0), timeToFirstResult(0), loadSeconds(0), framesDropped(0), rmsdCalculations(0), allocations(0), screened(0),
+          valueLookups(0), valueHits(0), allocationLookups(0), allocationHits(0), threads(0), pairThreads(1), frames(0), running(false), stopLatency(0) {}
+};
+
+class LocalSearch : public Evaluator {
+  private:
+    std::atomic<bool> running;
+    // set once per-thread state exists, so stats() never reads it half built
+    std::atomic<int> threads;
+    double elapsedSeconds;
+    // seconds every thread stopped after the time limit, negative if it stopped before
+    std::vector<double> stopLatencies;
+    StopLatencyHistogram stopHistogram;
+
+    void initStopLatencies(int threadsCount) {
+        stopLatencies.assign(threadsCount, -1);
+    }
+
+    void collectStopLatencies() {
+        stopHistogram = StopLatencyHistogram();
+        for (double late : stopLatencies) {
+            if (late >= 0) {
+                stopHistogram.add(late);
+            }
+        }
+    }
+
+    // every thread gets its own generator, seeded from the search seed and its thread id
+    void seedThread() {
+        seedRandom(seed ^ ((unsigned)omp_thread_id + 1) * 2654435761u);
+    }
+
+  public:
+    Portfolio portfolio;
+    // drawn from rand() when the search is created, set before running to repeat a search
+    unsigned seed;
+
+    LocalSearch(const Trajectory &trajectory, const Config &searchConfig, std::shared_ptr<const FingerprintIndex> prebuiltIndex = nullptr,
+                std::shared_ptr<ResidentCache> residentCache = nullptr)
+        : Evaluator(trajectory, searchConfig, prebuiltIndex, residentCache), running(false), threads(0), elapsedSeconds(0),
+          seed(rand()) {}
+
+    // looping over routes until the deadline token expires; a route is a chain of steps each depending
+    // on the previous one, so routes are the unit of work and every thread draws its own starting pairs
+    void searchRoutes() {
+        bool usePortfolio = config.searchStrategy == "portfolio";
+        std::unique_ptr<SearchStrategy> strategies[Portfolio::STRATEGIES];
+        int current = 0;
+        if (usePortfolio) {
+            for (int s = 0; s < Portfolio::STRATEGIES; s++) {
+                strategies[s] = createStrategy(Portfolio::strategyName(s), *this);
+            }
+            // threads start spread over all strategies
+            current = omp_get_thread_num() % Portfolio::STRATEGIES;
+        } else {
+            strategies[0] = createStrategy(config.searchStrategy, *this);
+        }
+
+        while (!timeExceeded()) {
+            // one route
+            int i, j;
+            extendToNewFrames();
+            choosePairRandom(i, j);
+
+            auto routeStart = std::chrono::steady_clock::now();
+            routeGain[omp_thread_id] = 0;
+            LocalSearchResult routeBest = strategies[current]->route(i, j);
+            // improvements published during the route and a start value never offered as route best
+            double improvement = routeGain[omp_thread_id] + saveIfBest(routeBest.rmsdValue, routeBest.i, routeBest.j);
+            topK.flush(omp_thread_id);
+
+            if (usePortfolio) {
+                std::chrono::duration<double> routeElapsed = std::chrono::steady_clock::now() - routeStart;
+                portfolio.record(current, improvement, routeElapsed.count());
+                current = portfolio.choose();
+            }
+        }
+        if (!cancelled) {
+            stopLatencies[omp_thread_id] = deadline.secondsLate(std::chrono::steady_clock::now());
+        }
+    }
+
+    // per-sphere maxima kept by threads while searching, and sphere RMSDs of top pairs calculated again;
+    // top pairs are stored as (smaller, larger) frame, so spheres are allocated on the frame giving the reported value
+    SphereMap sphereMap(const std::vector<TopKPairs::Entry> &topPairs) {
+        SphereMap result;
+        rmsd.sphereMaxima(result.maxima, result.maximaI, result.maximaJ);
+        for (const TopKPairs::Entry &e : topPairs) {
+            std::vector<double> forward = rmsd.sphereRMSDs(e.i, e.j);
+            std::vector<double> backward = rmsd.sphereRMSDs(e.j, e.i);
+            double forwardSum = std::accumulate(forward.begin(), forward.end(), 0.0);
+            double backwardSum = std::accumulate(backward.begin(), backward.end(), 0.0);
+            bool forwardMatches = std::abs(forwardSum - e.rmsdValue) <= std::abs(backwardSum - e.rmsdValue);
+            result.pairs.push_back(forwardMatches ? forward : backward);
+        }
+        return result;
+    }
+
+    static double rmsdPerSecond(const SearchStats &stats) {
+        return stats.elapsedSeconds > 0 ? stats.rmsdCalculations / stats.elapsedSeconds : 0;
+    }
+
+    // number of threads run() starts
+    int threadsToRun() {
+        if (config.ompThreads > 0) {
+            return config.ompThreads;
+        }
+        return std::max(1, (int)(omp_get_num_procs() * config.ompThreadsPerCore));
+    }
+
+    // threadsToRun() threads split into route threads, each with a nested team of pair threads calculating
+    // the spheres of its pairs. Routes are independent and need no synchronisation, so they get every thread
+    // unless spheres are many: with intraPairThreads 0 a pair is split only between threads getting at least
+    // intraPairMinSpheres spheres each, otherwise the nested team costs more than it saves. Nested teams wait
+    // for each other at every pair, so they are not chosen beyond the number of cpu cores
+    void splitThreads(int total, int &routeThreads, int &pairThreads) {
+        if (config.intraPairThreads > 0) {
+            pairThreads = std::min(config.intraPairThreads, total);
+        } else {
+            int cores = std::min(total, omp_get_num_procs());
+            pairThreads = std::max(1, std::min(cores, trajectory.spheres / std::max(config.intraPairMinSpheres, 1)));
+        }
+        routeThreads = std::max(1, total / pairThreads);
+        pairThreads = std::max(1, total / routeThreads);
+    }
+
+    // whole search on threadsToRun() threads, without any output
+    SearchStats search() {
+        int threadsCount, pairThreads;
+        splitThreads(threadsToRun(), threadsCount, pairThreads);
+        rmsd.intraPairThreads = pairThreads;
+        if (pairThreads > 1) {
+            omp_set_max_active_levels(std::max(omp_get_max_active_levels(), 2));
+        }
+        std::vector<int> threadNodes(threadsCount, 0);
+
+        initThreads(threadsCount);
+        initStopLatencies(threadsCount);
+        threads = threadsCount;
+        portfolio.reset();
+        start = std::chrono::steady_clock::now();
+        deadline.init(threadsCount, start, config.timeLimitMinutes * 60, config.stopLatencyMs / 1000);
+        running = true;
+
+#pragma omp parallel num_threads(threadsCount)
+        {
+            omp_thread_id = omp_get_thread_num();
+            omp_numa_node = numaTopology().pinCurrentThread(config.threadAffinity, omp_thread_id);
+            threadNodes[omp_thread_id] = omp_numa_node;
+            seedThread();
+            if (omp_thread_id == 0) {
+                searchLog("[OMP] [Number of threads]: ", omp_get_num_threads(), " routes x ", pairThreads, " per pair");
+            }
+
+            searchRoutes();
+        }
+
+        auto stop = std::chrono::steady_clock::now();
+        std::chrono::duration<double> elapsed = stop - start;
+        elapsedSeconds = elapsed.count();
+        collectStopLatencies();
+        running = false;
+        // reported matrix covers frames appended while following
+        config.matrixSize = matrixSize();
+        if (DEBUG && numaTopology().nodes() > 1) {
+            std::vector<int> threadsPerNode(numaTopology().nodes(), 0);
+            for (int node : threadNodes) {
+                threadsPerNode[node]++;
+            }
+            std::cout << " - Threads per NUMA node (" << config.threadAffinity << "):";
+            for (int count : threadsPerNode) {
+                std::cout << " " << count;
+            }
+            std::cout << std::endl;
+        }
+        return stats();
+    }
+
+    SearchStats run() {
+        SearchStats result = search();
+        print("Local Search Results:");
+        print(" - Computation time: ", elapsedSeconds, "s");
+        if (result.pairThreads > 1) {
+            print(" - Threads: ", result.threads, " routes, ", result.pairThreads, " threads per pair.");
+        }
+        if (growing()) {
+            print(" - Frames searched: ", result.frames, " (", result.frames - startMatrixSize, " appended while searching).");
+        }
+        print(" - RMSD counted: ", result.rmsdCalculations, " times (", rmsdPerSecond(result), " per second).");
+        print(" - Atoms: ", trajectory.atoms, " of ", trajectory.atomsInFile, " selected by \"", trajectory.selection,
+              "\", coordinates: ", trajectory.A.memoryBytes(), " bytes.");
+        print(" - Atoms allocated: ", result.allocations, " times.");
+        print(" - Time to best: ", timeToBest, "s");
+        if (result.loadSeconds > 0) {
+            print(" - Time to first result: ", result.timeToFirstResult, "s after loading started, loading took ", result.loadSeconds, "s.");
+        } else {
+            print(" - Time to first result: ", result.timeToFirstResult, "s after loading started, still loading.");
+        }
+        if (result.framesDropped > 0) {
+            print(" - Load error: ", result.framesDropped, " frames of the file were not read, coordinates had room for ",
+                  trajectory.A.size(), " frames.");
+        }
+        if (stopHistogram.total() > 0) {
+            print(" - Stopped after time limit: max ", stopHistogram.max() * 1000, "ms (", stopHistogram.buckets(), ").");
+        }
+        if (config.verletSkin > 0) {
+            int reused, rebuilt;
+            rmsd.skinStats(reused, rebuilt);
+            print(" - Neighbour lists: reused ", reused, " times, rebuilt ", rebuilt, " times.");
+        }
+        if (config.fingerprintIndex) {
+            print(" - Fingerprint index: built in ", index->buildSeconds, "s, ", index->memoryBytes(), " bytes.");
+        }
+        if (config.coarseScreening) {
+            print(" - Screened out by coarse score: ", result.screened, " times (coarse data: ", rmsd.coarse.memoryBytes(), " bytes).");
+        }
+        if (rmsd.cache) {
+            print(" - Resident cache: pair values ", result.valueHits, " hits of ", result.valueLookups,
+                  ", allocations ", result.allocationHits, " hits of ", result.allocationLookups, ".");
+        }
+        if (config.searchStrategy == "portfolio") {
+            print(" - Portfolio:");
+            portfolio.print();
+        }
+
+        if (!result.radii.empty()) {
+            print(" - Best pair of every sphere radius:");
+            for (size_t r = 0; r < result.radii.size(); r++) {
+                const LocalSearchResult &best = result.radiusBest[r];
+                print("   ", result.radii[r], (result.radii[r] == config.sphereRadius ? " (searched)" : ""), ": [", best.i, ", ", best.j,
+                      "] = ", best.rmsdValue);
+            }
+        }
+
+        if (config.topK > 1) {
+            print(" - Top ", result.topPairs.size(), " pairs:");
+            for (const TopKPairs::Entry &e : result.topPairs) {
+                print("   [", e.i, ", ", e.j, "] = ", e.rmsdValue);
+            }
+        }
+
+        if (config.sphereMap) {
+            result.sphereMap = sphereMap(result.topPairs);
+            if (FileManager::writeSphereMap(config, trajectory, result.topPairs, result.sphereMap)) {
+                print(" - Sphere map: ", config.sphereMapFilename);
+            }
+        }
+
+        if (config.writeAsCSV) {
+            FileManager::writeResultsAsCSV(config, bestResult.i, bestResult.j, bestResult.rmsdValue, elapsedSeconds, result.topPairs);
+        }
+        if (config.writeAsJSON) {
+            FileManager::writeResultsAsJSON(config, bestResult.i, bestResult.j, bestResult.rmsdValue, elapsedSeconds, result.topPairs,
+                                            trajectory, rmsdPerSecond(result));
+        }
+
+        return result;
+    }
+
+    // whole search on the calling thread of an already running parallel region, without any output;
+    // omp_thread_id of the calling thread has to be set
+    SearchStats searchOnCurrentThread() {
+        // state for every thread id of the region, only the calling thread's one is used
+        initThreads(omp_get_num_threads());
+        initStopLatencies(omp_get_num_threads());
+        threads = omp_get_num_threads();
+        portfolio.reset();
+        seedThread();
+        start = std::chrono::steady_clock::now();
+        deadline.init(omp_get_num_threads(), start, config.timeLimitMinutes * 60, config.stopLatencyMs / 1000);
+        running = true;
+
+        searchRoutes();
+
+        auto stop = std::chrono::steady_clock::now();
+        std::chrono::duration<double> elapsed = stop - start;
+        elapsedSeconds = elapsed.count();
+        collectStopLatencies();
+        running = false;
+        return stats();
+    }
+
+    // the same, writing results as one batch line
+    void runOnCurrentThread() {
+        SearchStats result = searchOnCurrentThread();
+
+#pragma omp critical(output)
+        {
+            FileManager::writeResultsAsCSV(config, bestResult.i, bestResult.j, bestResult.rmsdValue, elapsedSeconds, result.topPairs);
+            if (config.writeAsJSON) {
+                FileManager::writeResultsAsJSON(config, bestResult.i, bestResult.j, bestResult.rmsdValue, elapsedSeconds, result.topPairs,
+                                                trajectory, rmsdPerSecond(result));
+            }
+        }
+    }
+
+    // safe to call from any thread while the search runs
+    SearchStats stats() {
+        SearchStats result;
+        result.running = running;
+        result.threads = threads;
+        result.pairThreads = rmsd.intraPairThreads;
+        result.frames = matrixSize();
+        result.loadSeconds = trajectory.loadSeconds;
+        result.framesDropped = trajectory.framesDropped;
+#pragma omp critical(bestResult)
+        {
+            result.best = bestResult;
+            result.timeToBest = timeToBest;
+            result.timeToFirstResult = timeToFirstResult;
+        }
+        if (result.running) {
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            result.elapsedSeconds = elapsed.count();
+            result.topPairs = topK.snapshot();
+        } else {
+            result.elapsedSeconds = elapsedSeconds;
+            result.topPairs = topK.results();
+            result.stopLatency = stopHistogram.max();
+#pragma omp critical(bestResult)
+            result.trace = incumbentTrace;
+            if (rmsd.radii.size() > 1 && threads > 0) {
+                std::vector<double> values;
+                std::vector<int> i, j;
+                rmsd.radiusMaxima(values, i, j);
+                result.radii = rmsd.radii;
+                for (size_t r = 0; r < values.size(); r++) {
+                    result.radiusBest.push_back({values[r], i[r], j[r]});
+                }
+            }
+        }
+        if (threads > 0) {
+            rmsd.counters(result.rmsdCalculations, result.allocations, result.screened);
+            rmsd.cacheCounters(result.valueLookups, result.valueHits, result.allocationLookups, result.allocationHits);
+        }
+        return result;
+    }
+};
+
+#endif // LOCAL_SEARCH_H
@@ -0,0 +1,156 @@
+#include "local_search_api.h"
+
+#include <algorithm>
+#include <sstream>
+
+bool DEBUG = true;
+bool DEBUG_RMSD = false;
+bool AlreadyShowedRMSDCalculationCount = false;
+int omp_thread_id = 0;
+int omp_numa_node = 0;
+unsigned random_state = 1;
+
+SearchContext::SearchContext() : searchesCount(0) {}
+
+SearchContext::~SearchContext() {
+    cancel();
+    follower.reset();
+}
+
+int SearchContext::load(const Config &config) {
+    std::shared_ptr<Trajectory> trajectory = std::make_shared<Trajectory>();
+    if (config.follow || config.streamLoad) {
+        std::unique_ptr<TrajectoryFollower> newFollower(new TrajectoryFollower(trajectory));
+        int result = newFollower->open(config);
+        if (result != 0) {
+            return result;
+        }
+        load(std::shared_ptr<const Trajectory>(trajectory));
+        std::lock_guard<std::mutex> lock(mutex);
+        follower = std::move(newFollower);
+        return 0;
+    }
+    FileManager fileManager;
+    int result = fileManager.readTrajectory(config, *trajectory);
+    if (result != 0) {
+        return result;
+    }
+    load(std::shared_ptr<const Trajectory>(trajectory));
+    return 0;
+}
+
+void SearchContext::load(std::shared_ptr<const Trajectory> trajectory) {
+    std::unique_ptr<TrajectoryFollower> previous;
+    std::lock_guard<std::mutex> lock(mutex);
+    // stopped outside of the lock, the follower keeps its trajectory alive until then
+    previous = std::move(follower);
+    current = trajectory;
+    indexes.clear();
+    cache = nullptr;
+}
+
+bool SearchContext::loaded() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return current != nullptr;
+}
+
+std::shared_ptr<const Trajectory> SearchContext::trajectory() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return current;
+}
+
+std::shared_ptr<const FingerprintIndex> SearchContext::fingerprintIndex(const Config &config, bool *warm) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (warm != nullptr) {
+        *warm = false;
+    }
+    if (!current || !config.fingerprintIndex || current->loading) {
+        return nullptr;
+    }
+    // the same range as Evaluator resolves
+    int frames = current->available;
+    int frameFrom = std::min(std::max(config.frameFrom, 0), std::max(frames - 2, 0));
+    int matrixSize = config.matrixSize;
+    if (matrixSize == -1 || frameFrom + matrixSize > frames) {
+        matrixSize = frames - frameFrom;
+    }
+    std::pair<int, int> key = std::make_pair(frameFrom + matrixSize, config.fingerprintPairs);
+    auto found = indexes.find(key);
+    if (found != indexes.end()) {
+        if (warm != nullptr) {
+            *warm = true;
+        }
+        return found->second;
+    }
+    std::shared_ptr<FingerprintIndex> index = std::make_shared<FingerprintIndex>();
+    index->build(*current, frameFrom + matrixSize, config.fingerprintPairs);
+    indexes[key] = index;
+    return index;
+}
+
+std::shared_ptr<ResidentCache> SearchContext::residentCache(const Config &config) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!current || !config.residentCache) {
+        return nullptr;
+    }
+    std::string settings = cacheSettings(config);
+    if (!cache || cachedSettings != settings) {
+        cache = std::make_shared<ResidentCache>(std::max(config.cachePairs, 0), std::max(config.cacheAllocations, 0));
+        cachedSettings = settings;
+    }
+    return cache;
+}
+
+std::string SearchContext::cacheSettings(const Config &config) const {
+    std::ostringstream settings;
+    settings.precision(17);
+    settings << config.sphereRadius << ";" << config.fixedSizeKernels << ";" << current->A.quantised() << ";" << config.coarseScreening;
+    if (config.coarseScreening) {
+        settings << ";" << config.coarseSpheres << ";" << config.coarseMargin;
+    }
+    return settings.str();
+}
+
+SearchStats SearchContext::search(const Config &config) {
+    std::shared_ptr<const Trajectory> trajectory = this->trajectory();
+    if (!trajectory) {
+        return SearchStats();
+    }
+    LocalSearch localSearch(*trajectory, config, fingerprintIndex(config), residentCache(config));
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running.push_back(&localSearch);
+        searchesCount++;
+    }
+    SearchStats result = localSearch.run();
+    std::lock_guard<std::mutex> lock(mutex);
+    running.erase(std::find(running.begin(), running.end(), &localSearch));
+    lastStats = result;
+    return result;
+}
+
+SearchStats SearchContext::search(const Config &config, double timeBudgetSeconds) {
+    Config budgeted = config;
+    budgeted.timeLimitMinutes = timeBudgetSeconds / 60;
+    return search(budgeted);
+}
+
+void SearchContext::cancel() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (LocalSearch *localSearch : running) {
+        localSearch->cancelled = true;
+    }
+}
+
+SearchStats SearchContext::stats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!running.empty()) {
+        return running.back()->stats();
+    }
+    return lastStats;
+}
+
+int SearchContext::searches() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return searchesCount;
+}
@@ -0,0 +1,74 @@
+#ifndef LOCAL_SEARCH_API_H
+#define LOCAL_SEARCH_API_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "fingerprint_index.h"
+#include "globals.h"
+#include "local_search.h"
+#include "resident_cache.h"
+#include "trajectory.h"
+#include "trajectory_follower.h"
+
+// Embeddable search engine (liblocal_search). A context owns the loaded trajectory and the caches
+// built on it, and keeps them warm between searches. Searches run on the OpenMP thread team of
+// the calling thread, which the runtime keeps alive between searches. Every method may be called
+// from any thread, and several searches may run on one context at the same time.
+class SearchContext {
+  private:
+    std::mutex mutex;
+    // replaced by load(), running searches keep their trajectory alive
+    std::shared_ptr<const Trajectory> current;
+    // appending frames to the current trajectory in follow mode
+    std::unique_ptr<TrajectoryFollower> follower;
+    // fingerprint indexes by (indexed frames, fingerprintPairs)
+    std::map<std::pair<int, int>, std::shared_ptr<const FingerprintIndex>> indexes;
+    std::shared_ptr<ResidentCache> cache;
+    // cacheSettings() of the config the cached values and allocations were calculated with
+    std::string cachedSettings;
+    std::vector<LocalSearch *> running;
+    SearchStats lastStats;
+    int searchesCount;
+
+    // every setting the cached values or allocations depend on; the coordinate precision is the one
+    // of the loaded trajectory, a new trajectory drops the cache anyway
+    std::string cacheSettings(const Config &config) const;
+
+  public:
+    SearchContext();
+    ~SearchContext();
+
+    // reading config.trajectoryFilename, dropping caches of the previous trajectory; returns 0 on success.
+    // With config.streamLoad or config.follow it returns once the first frames are read, the rest is read
+    // (or the file is tailed) in the background, and searches extend to frames published later
+    int load(const Config &config);
+    // using trajectory prepared by the caller, e.g. borrowing coordinates of an array
+    void load(std::shared_ptr<const Trajectory> trajectory);
+    bool loaded();
+    std::shared_ptr<const Trajectory> trajectory();
+
+    // fingerprint index for config, built on the first request and shared by later searches;
+    // warm is set if the index was already built
+    std::shared_ptr<const FingerprintIndex> fingerprintIndex(const Config &config, bool *warm = nullptr);
+    // pair values and allocations kept for the loaded trajectory, created on the first request
+    std::shared_ptr<ResidentCache> residentCache(const Config &config);
+
+    // searching loaded trajectory until config.timeLimitMinutes passes or cancel() is called
+    SearchStats search(const Config &config);
+    // the same with time budget given in seconds
+    SearchStats search(const Config &config, double timeBudgetSeconds);
+
+    // stopping every running search, they return their best result so far
+    void cancel();
+
+    // the latest running search, or the last finished one if none runs
+    SearchStats stats();
+    int searches();
+};
+
+#endif // LOCAL_SEARCH_API_H
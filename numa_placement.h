@@ -0,0 +1,200 @@
+#ifndef NUMA_PLACEMENT_H
+#define NUMA_PLACEMENT_H
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// NUMA topology read from sysfs, memory policies set with raw syscalls, so no libnuma is needed.
+// On a single node box every call falls back to plain behaviour; fake NUMA nodes
+// (kernel parameter numa=fake=N) are seen like real ones.
+class NumaTopology {
+  private:
+    static const int MPOL_BIND_MODE = 2;
+    static const int MPOL_INTERLEAVE_MODE = 3;
+    static const int MAX_NODES = 64;
+
+    // "0-3,8-11" -> {0, 1, 2, 3, 8, 9, 10, 11}
+    static std::vector<int> parseList(const std::string &list) {
+        std::vector<int> result;
+        std::istringstream iss(list);
+        std::string range;
+        while (std::getline(iss, range, ',')) {
+            if (range.empty() || range == "\n") {
+                continue;
+            }
+            size_t dash = range.find('-');
+            int from = std::stoi(range.substr(0, dash));
+            int to = dash == std::string::npos ? from : std::stoi(range.substr(dash + 1));
+            for (int c = from; c <= to; c++) {
+                result.push_back(c);
+            }
+        }
+        return result;
+    }
+
+    long bindMemory(void *address, size_t bytes, int mode, const std::vector<int> &nodes) {
+        unsigned long mask = 0;
+        for (int node : nodes) {
+            mask |= 1UL << node;
+        }
+        return syscall(SYS_mbind, address, bytes, mode, &mask, MAX_NODES + 1, 0);
+    }
+
+  public:
+    // cpus of every node
+    std::vector<std::vector<int>> nodeCPUs;
+
+    NumaTopology() {
+        std::ifstream online("/sys/devices/system/node/online");
+        std::string line;
+        if (online.is_open() && std::getline(online, line)) {
+            for (int node : parseList(line)) {
+                std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+                std::string cpus;
+                std::getline(cpulist, cpus);
+                if ((int)nodeCPUs.size() <= node) {
+                    nodeCPUs.resize(node + 1);
+                }
+                nodeCPUs[node] = parseList(cpus);
+            }
+        }
+        if (nodeCPUs.empty()) {
+            nodeCPUs.push_back({});
+            for (int c = 0; c < sysconf(_SC_NPROCESSORS_ONLN); c++) {
+                nodeCPUs[0].push_back(c);
+            }
+        }
+    }
+
+    int nodes() {
+        return nodeCPUs.size();
+    }
+
+    int nodeOfCPU(int cpu) {
+        for (int node = 0; node < nodes(); node++) {
+            for (int c : nodeCPUs[node]) {
+                if (c == cpu) {
+                    return node;
+                }
+            }
+        }
+        return 0;
+    }
+
+    // compact: thread t on t-th cpu, filling nodes one by one,
+    // spread: threads dealt round robin over nodes; returns the node of the thread
+    int pinCurrentThread(const std::string &affinity, int thread) {
+        if (affinity != "compact" && affinity != "spread") {
+            return nodeOfCPU(sched_getcpu());
+        }
+        std::vector<int> order;
+        if (affinity == "compact") {
+            for (auto &cpus : nodeCPUs) {
+                order.insert(order.end(), cpus.begin(), cpus.end());
+            }
+        } else {
+            for (size_t k = 0; order.size() < (size_t)sysconf(_SC_NPROCESSORS_ONLN); k++) {
+                bool any = false;
+                for (auto &cpus : nodeCPUs) {
+                    if (k < cpus.size()) {
+                        order.push_back(cpus[k]);
+                        any = true;
+                    }
+                }
+                if (!any) {
+                    break;
+                }
+            }
+        }
+        if (order.empty()) {
+            return 0;
+        }
+        int cpu = order[thread % order.size()];
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        return nodeOfCPU(cpu);
+    }
+
+    // hugePages: none, transparent (madvise) or explicit (MAP_HUGETLB, falls back to transparent);
+    // node: -1 no policy, -2 interleaved over all nodes, otherwise bound to that node, null if it cannot be bound.
+    // Policy is set before the first touch, so pages land where requested. With huge pages the mapping is
+    // rounded up to whole huge pages, mappedBytes is the length to munmap() it with.
+    void *allocate(size_t bytes, const std::string &hugePages, int node, std::string &hugePagesResult, size_t &mappedBytes) {
+        const size_t HUGE_PAGE = 2 * 1024 * 1024;
+        if (hugePages != "none") {
+            bytes = (bytes + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+        }
+        mappedBytes = bytes;
+        void *address = MAP_FAILED;
+        hugePagesResult = "none";
+        if (hugePages == "explicit") {
+            address = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (address != MAP_FAILED) {
+                hugePagesResult = "explicit";
+            }
+        }
+        if (address == MAP_FAILED) {
+            address = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (address == MAP_FAILED) {
+                return nullptr;
+            }
+            if (hugePages != "none" && madvise(address, bytes, MADV_HUGEPAGE) == 0) {
+                hugePagesResult = "transparent";
+            }
+        }
+        std::vector<int> all;
+        for (int n = 0; n < nodes(); n++) {
+            all.push_back(n);
+        }
+        if (node == -2 && nodes() > 1) {
+            bindMemory(address, bytes, MPOL_INTERLEAVE_MODE, all);
+        } else if (node >= 0 && nodes() > 1 && bindMemory(address, bytes, MPOL_BIND_MODE, {node}) != 0) {
+            // e.g. a node without memory
+            munmap(address, bytes);
+            return nullptr;
+        }
+        return address;
+    }
+
+    // number of pages on every node, checked for up to `samples` pages spread over the region
+    std::vector<int> pagesPerNode(void *address, size_t bytes, int samples = 1024) {
+        std::vector<int> result(nodes(), 0);
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t pages = (bytes + page - 1) / page;
+        if (pages == 0) {
+            return result;
+        }
+        size_t step = std::max<size_t>(1, pages / samples);
+        std::vector<void *> addresses;
+        for (size_t p = 0; p < pages; p += step) {
+            addresses.push_back((char *)address + p * page);
+        }
+        std::vector<int> status(addresses.size(), -1);
+        if (syscall(SYS_move_pages, 0, addresses.size(), addresses.data(), nullptr, status.data(), 0) != 0) {
+            return result;
+        }
+        for (int s : status) {
+            if (s >= 0 && s < nodes()) {
+                result[s]++;
+            }
+        }
+        return result;
+    }
+};
+
+inline NumaTopology &numaTopology() {
+    static NumaTopology topology;
+    return topology;
+}
+
+#endif // NUMA_PLACEMENT_H
@@ -0,0 +1,309 @@
+// Python bindings of liblocal_search.
+// Coordinates are taken through the buffer protocol, so any C-contiguous (frames x atoms x 3) array
+// (NumPy, MDAnalysis positions, memoryview) is read in place: float64 arrays without any copy,
+// float32 arrays are converted once into own store. Searches run with the GIL released.
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../file_manager.h"
+#include "../local_search_api.h"
+
+struct ContextObject {
+    PyObject_HEAD
+    SearchContext *context;
+    Config *config;
+};
+
+// buffer stays exported (array can't be resized) as long as any search may read it
+struct BorrowedBuffer {
+    Py_buffer view;
+    ~BorrowedBuffer() {
+        PyGILState_STATE state = PyGILState_Ensure();
+        PyBuffer_Release(&view);
+        PyGILState_Release(state);
+    }
+};
+
+// "d", "<d", "=d" and "@d" are all native doubles on little endian machines
+static char bufferType(const Py_buffer &view) {
+    if (view.format == nullptr) {
+        return 'B';
+    }
+    std::string format(view.format);
+    if (!format.empty() && (format[0] == '<' || format[0] == '=' || format[0] == '@')) {
+        format = format.substr(1);
+    }
+    return format.size() == 1 ? format[0] : 0;
+}
+
+// keyword arguments use config.yml keys, e.g. timeLimitMinutes=0.5, searchStrategy="tabu"
+static bool applyKeywords(Config &config, PyObject *kwargs) {
+    if (kwargs == nullptr) {
+        return true;
+    }
+    std::unordered_map<std::string, std::string> configMap;
+    PyObject *key, *value;
+    Py_ssize_t position = 0;
+    while (PyDict_Next(kwargs, &position, &key, &value)) {
+        std::string text;
+        if (PyBool_Check(value)) {
+            text = value == Py_True ? "true" : "false";
+        } else {
+            PyObject *str = PyObject_Str(value);
+            if (str == nullptr) {
+                return false;
+            }
+            text = PyUnicode_AsUTF8(str);
+            Py_DECREF(str);
+        }
+        configMap[PyUnicode_AsUTF8(key)] = text;
+    }
+    try {
+        FileManager::applyConfigMap(config, configMap);
+    } catch (const std::exception &e) {
+        PyErr_SetString(PyExc_ValueError, e.what());
+        return false;
+    }
+    if (!strategyNameValid(config.searchStrategy)) {
+        PyErr_Format(PyExc_ValueError, "Unknown search strategy: %s", config.searchStrategy.c_str());
+        return false;
+    }
+    if (!sphereRadiiError(config).empty()) {
+        PyErr_SetString(PyExc_ValueError, sphereRadiiError(config).c_str());
+        return false;
+    }
+    return true;
+}
+
+static PyObject *pairTuple(int i, int j, double rmsdValue) {
+    return Py_BuildValue("(iid)", i, j, rmsdValue);
+}
+
+static PyObject *statsDict(const SearchStats &stats) {
+    PyObject *top = PyList_New(stats.topPairs.size());
+    for (size_t k = 0; k < stats.topPairs.size(); k++) {
+        PyList_SET_ITEM(top, k, pairTuple(stats.topPairs[k].i, stats.topPairs[k].j, stats.topPairs[k].rmsdValue));
+    }
+    PyObject *best = pairTuple(stats.best.i, stats.best.j, stats.best.rmsdValue);
+    PyObject *sphereMax = PyList_New(stats.sphereMap.maxima.size());
+    for (size_t s = 0; s < stats.sphereMap.maxima.size(); s++) {
+        PyList_SET_ITEM(sphereMax, s, pairTuple(stats.sphereMap.maximaI[s], stats.sphereMap.maximaJ[s], stats.sphereMap.maxima[s]));
+    }
+    PyObject *topSpheres = PyList_New(stats.sphereMap.pairs.size());
+    for (size_t k = 0; k < stats.sphereMap.pairs.size(); k++) {
+        PyObject *spheres = PyList_New(stats.sphereMap.pairs[k].size());
+        for (size_t s = 0; s < stats.sphereMap.pairs[k].size(); s++) {
+            PyList_SET_ITEM(spheres, s, PyFloat_FromDouble(stats.sphereMap.pairs[k][s]));
+        }
+        PyList_SET_ITEM(topSpheres, k, spheres);
+    }
+    PyObject *radiusBest = PyList_New(stats.radii.size());
+    for (size_t r = 0; r < stats.radii.size(); r++) {
+        const LocalSearchResult &e = stats.radiusBest[r];
+        PyList_SET_ITEM(radiusBest, r, Py_BuildValue("(diid)", stats.radii[r], e.i, e.j, e.rmsdValue));
+    }
+    PyObject *result = Py_BuildValue("{s:N,s:N,s:d,s:d,s:d,s:d,s:l,s:l,s:l,s:i,s:i,s:i,s:O,s:N,s:N,s:N}",
+                                     "best", best,
+                                     "top", top,
+                                     "elapsed", stats.elapsedSeconds,
+                                     "time_to_best", stats.timeToBest,
+                                     "time_to_first_result", stats.timeToFirstResult,
+                                     "stop_latency", stats.stopLatency,
+                                     "rmsd_calculations", stats.rmsdCalculations,
+                                     "allocations", stats.allocations,
+                                     "screened", stats.screened,
+                                     "threads", stats.threads,
+                                     "frames", stats.frames,
+                                     "frames_dropped", stats.framesDropped,
+                                     "running", stats.running ? Py_True : Py_False,
+                                     "sphere_max", sphereMax,
+                                     "top_spheres", topSpheres,
+                                     "radius_best", radiusBest);
+    return result;
+}
+
+static PyObject *Context_new(PyTypeObject *type, PyObject *, PyObject *) {
+    ContextObject *self = (ContextObject *)type->tp_alloc(type, 0);
+    if (self != nullptr) {
+        self->context = new SearchContext();
+        self->config = new Config();
+        self->config->initDefault();
+        self->config->showLogs = false;
+        self->config->showDebugCurrentBest = false;
+    }
+    return (PyObject *)self;
+}
+
+static void Context_dealloc(ContextObject *self) {
+    delete self->context;
+    delete self->config;
+    PyTypeObject *type = Py_TYPE(self);
+    type->tp_free((PyObject *)self);
+    Py_DECREF(type);
+}
+
+// load(coordinates, ca_mask): coordinates (frames, atoms, 3) float64 or float32, ca_mask (atoms,) of bool/uint8
+static PyObject *Context_load(ContextObject *self, PyObject *args) {
+    PyObject *coordinatesObject, *maskObject;
+    if (!PyArg_ParseTuple(args, "OO", &coordinatesObject, &maskObject)) {
+        return nullptr;
+    }
+    std::shared_ptr<BorrowedBuffer> coordinates = std::make_shared<BorrowedBuffer>();
+    if (PyObject_GetBuffer(coordinatesObject, &coordinates->view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0) {
+        return nullptr;
+    }
+    Py_buffer &view = coordinates->view;
+    char type = bufferType(view);
+    if (view.ndim != 3 || view.shape[2] != 3 || (type != 'd' && type != 'f')) {
+        PyErr_SetString(PyExc_ValueError, "coordinates have to be a C-contiguous (frames, atoms, 3) float64 or float32 array");
+        return nullptr;
+    }
+    // searches draw pairs of different frames
+    if (view.shape[0] < 2) {
+        PyErr_SetString(PyExc_ValueError, "coordinates need at least 2 frames");
+        return nullptr;
+    }
+    int frames = view.shape[0];
+    int atoms = view.shape[1];
+
+    Py_buffer mask;
+    if (PyObject_GetBuffer(maskObject, &mask, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0) {
+        return nullptr;
+    }
+    std::vector<int> CAAtoms;
+    bool maskValid = mask.itemsize == 1 && mask.len == atoms;
+    for (int a = 0; maskValid && a < atoms; a++) {
+        if (((const unsigned char *)mask.buf)[a]) {
+            CAAtoms.push_back(a);
+        }
+    }
+    PyBuffer_Release(&mask);
+    if (!maskValid || CAAtoms.empty()) {
+        PyErr_SetString(PyExc_ValueError, "ca_mask has to be a bool or uint8 array of length atoms with at least one CA");
+        return nullptr;
+    }
+
+    if (type == 'd') {
+        // trajectory keeps the buffer exported until the last search using it is gone
+        Trajectory *trajectory = new Trajectory();
+        trajectory->borrow((double *)view.buf, frames, atoms, CAAtoms);
+        self->context->load(std::shared_ptr<const Trajectory>(trajectory, [coordinates](const Trajectory *t) {
+            delete t;
+        }));
+    } else {
+        std::shared_ptr<Trajectory> trajectory = std::make_shared<Trajectory>();
+        if (!trajectory->assign((const float *)view.buf, frames, atoms, CAAtoms)) {
+            return PyErr_NoMemory();
+        }
+        self->context->load(trajectory);
+    }
+    Py_RETURN_NONE;
+}
+
+// search(**config): blocking search on the loaded trajectory with the GIL released
+static PyObject *Context_search(ContextObject *self, PyObject *args, PyObject *kwargs) {
+    if (PyTuple_Size(args) != 0) {
+        PyErr_SetString(PyExc_TypeError, "search() takes only keyword arguments");
+        return nullptr;
+    }
+    if (!self->context->loaded()) {
+        PyErr_SetString(PyExc_RuntimeError, "no trajectory loaded");
+        return nullptr;
+    }
+    Config config = *self->config;
+    if (!applyKeywords(config, kwargs)) {
+        return nullptr;
+    }
+    SearchStats stats;
+    Py_BEGIN_ALLOW_THREADS
+    stats = self->context->search(config);
+    Py_END_ALLOW_THREADS
+    return statsDict(stats);
+}
+
+// configure(**config): defaults for later searches
+static PyObject *Context_configure(ContextObject *self, PyObject *args, PyObject *kwargs) {
+    if (PyTuple_Size(args) != 0) {
+        PyErr_SetString(PyExc_TypeError, "configure() takes only keyword arguments");
+        return nullptr;
+    }
+    Config config = *self->config;
+    if (!applyKeywords(config, kwargs)) {
+        return nullptr;
+    }
+    *self->config = config;
+    Py_RETURN_NONE;
+}
+
+static PyObject *Context_cancel(ContextObject *self, PyObject *) {
+    self->context->cancel();
+    Py_RETURN_NONE;
+}
+
+static PyObject *Context_stats(ContextObject *self, PyObject *) {
+    SearchStats stats;
+    Py_BEGIN_ALLOW_THREADS
+    stats = self->context->stats();
+    Py_END_ALLOW_THREADS
+    return statsDict(stats);
+}
+
+static PyMethodDef Context_methods[] = {
+    {"load", (PyCFunction)Context_load, METH_VARARGS,
+     "load(coordinates, ca_mask): use (frames, atoms, 3) float64 array in place, float32 arrays are converted once"},
+    {"search", (PyCFunction)(void (*)(void))Context_search, METH_VARARGS | METH_KEYWORDS,
+     "search(**config): run a search with the GIL released, config keys as in config.yml; returns best pair(s) and metrics"},
+    {"configure", (PyCFunction)(void (*)(void))Context_configure, METH_VARARGS | METH_KEYWORDS,
+     "configure(**config): set defaults of later searches"},
+    {"cancel", (PyCFunction)Context_cancel, METH_NOARGS, "cancel(): stop running searches, they return their best so far"},
+    {"stats", (PyCFunction)Context_stats, METH_NOARGS, "stats(): metrics of the running search, or of the last finished one"},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+static PyType_Slot Context_slots[] = {
+    {Py_tp_doc, (void *)"Search context owning a trajectory and caches built on it"},
+    {Py_tp_new, (void *)Context_new},
+    {Py_tp_dealloc, (void *)Context_dealloc},
+    {Py_tp_methods, (void *)Context_methods},
+    {0, nullptr},
+};
+
+static PyType_Spec Context_spec = {
+    "local_search.Context",
+    sizeof(ContextObject),
+    0,
+    Py_TPFLAGS_DEFAULT,
+    Context_slots,
+};
+
+static PyModuleDef localSearchModule = {
+    PyModuleDef_HEAD_INIT,
+    "local_search",
+    "Local search for the most deviating pair of trajectory frames",
+    -1,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+};
+
+PyMODINIT_FUNC PyInit_local_search(void) {
+    DEBUG = false;
+    PyObject *module = PyModule_Create(&localSearchModule);
+    if (module == nullptr) {
+        return nullptr;
+    }
+    PyObject *contextType = PyType_FromSpec(&Context_spec);
+    if (contextType == nullptr || PyModule_AddObject(module, "Context", contextType) < 0) {
+        Py_XDECREF(contextType);
+        Py_DECREF(module);
+        return nullptr;
+    }
+    return module;
+}
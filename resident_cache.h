@@ -0,0 +1,102 @@
+#ifndef RESIDENT_CACHE_H
+#define RESIDENT_CACHE_H
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Caches kept with a loaded trajectory and shared by every search on it, so later searches start warm:
+// RMSD values of frame pairs (sphere allocation frame first) and sphere allocations of frames.
+// Both are split into shards with own locks, so threads of concurrent searches rarely wait for each other.
+// A full shard drops an arbitrary entry, like the pair memory of one search does.
+class ResidentCache {
+  public:
+    typedef std::vector<std::vector<int>> Allocation;
+
+  private:
+    static const int SHARDS = 64;
+
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::unordered_map<long long, double> values;
+        std::unordered_map<int, std::shared_ptr<const Allocation>> allocations;
+    };
+
+    std::unique_ptr<Shard[]> shards;
+    size_t valuesPerShard;
+    size_t allocationsPerShard;
+
+    static inline long long pairKey(int f1, int f2) {
+        return ((long long)f1 << 32) | (unsigned)f2;
+    }
+
+    inline Shard &shard(long long key) {
+        return shards[(size_t)(key ^ (key >> 29)) % SHARDS];
+    }
+
+  public:
+    // capacities are numbers of pairs and of frames
+    ResidentCache(size_t valuesCapacity, size_t allocationsCapacity)
+        : shards(new Shard[SHARDS]),
+          valuesPerShard((valuesCapacity + SHARDS - 1) / SHARDS),
+          allocationsPerShard((allocationsCapacity + SHARDS - 1) / SHARDS) {}
+
+    bool findValue(int f1, int f2, double &value) {
+        long long key = pairKey(f1, f2);
+        Shard &s = shard(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto found = s.values.find(key);
+        if (found == s.values.end()) {
+            return false;
+        }
+        value = found->second;
+        return true;
+    }
+
+    void storeValue(int f1, int f2, double value) {
+        if (valuesPerShard == 0) {
+            return;
+        }
+        long long key = pairKey(f1, f2);
+        Shard &s = shard(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        if (s.values.size() >= valuesPerShard && s.values.find(key) == s.values.end()) {
+            s.values.erase(s.values.begin());
+        }
+        s.values[key] = value;
+    }
+
+    std::shared_ptr<const Allocation> findAllocation(int frame) {
+        Shard &s = shard(frame);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto found = s.allocations.find(frame);
+        return found == s.allocations.end() ? nullptr : found->second;
+    }
+
+    void storeAllocation(int frame, const Allocation &spheres) {
+        if (allocationsPerShard == 0) {
+            return;
+        }
+        std::shared_ptr<const Allocation> copy = std::make_shared<Allocation>(spheres);
+        Shard &s = shard(frame);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        if (s.allocations.size() >= allocationsPerShard && s.allocations.find(frame) == s.allocations.end()) {
+            s.allocations.erase(s.allocations.begin());
+        }
+        s.allocations[frame] = copy;
+    }
+
+    // numbers of cached pairs and frames
+    void sizes(size_t &values, size_t &allocations) {
+        values = 0;
+        allocations = 0;
+        for (int k = 0; k < SHARDS; k++) {
+            std::lock_guard<std::mutex> lock(shards[k].mutex);
+            values += shards[k].values.size();
+            allocations += shards[k].allocations.size();
+        }
+    }
+};
+
+#endif // RESIDENT_CACHE_H
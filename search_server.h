@@ -0,0 +1,370 @@
+#ifndef SEARCH_SERVER_H
+#define SEARCH_SERVER_H
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#include "file_manager.h"
+#include "globals.h"
+#include "local_search_api.h"
+#include "search_strategy.h"
+
+// Resident daemon answering search requests over a Unix domain socket.
+// Every message is a frame: 4-byte big endian payload length, then the payload.
+// Requests are "key: value" lines like config files, with `command` being load, search, cancel, unload, list or shutdown,
+// and `id` naming a resident trajectory. Responses are one JSON object with "status": "ok" or "error".
+// Every loaded trajectory keeps its own SearchContext with fingerprint indexes and resident cache, and searches of all
+// connections run concurrently, sharing serveThreads threads.
+class SearchServer {
+  private:
+    static const uint32_t MAX_FRAME = 1 << 20;
+
+    // threads of the pool not used by running searches
+    class ThreadBudget {
+      private:
+        std::mutex mutex;
+        std::condition_variable released;
+        int available;
+
+      public:
+        int total;
+
+        ThreadBudget(int threads) : available(threads), total(threads) {}
+
+        // waiting for at least one free thread, then taking up to requested ones
+        int acquire(int requested) {
+            std::unique_lock<std::mutex> lock(mutex);
+            released.wait(lock, [this] { return available > 0; });
+            int granted = std::min(std::max(requested, 1), available);
+            available -= granted;
+            return granted;
+        }
+
+        void release(int threads) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                available += threads;
+            }
+            released.notify_all();
+        }
+    };
+
+    Config baseConfig;
+    ThreadBudget budget;
+    std::mutex contextsMutex;
+    std::map<std::string, std::shared_ptr<SearchContext>> contexts;
+    std::mutex connectionsMutex;
+    std::condition_variable connectionsDone;
+    std::set<int> connections;
+    int listenSocket;
+    std::atomic<bool> stopping;
+
+    static std::string error(const std::string &message) {
+        return "{\"status\": \"error\", \"error\": " + FileManager::jsonString(message) + "}";
+    }
+
+    static bool readFully(int fd, char *buffer, size_t size) {
+        while (size > 0) {
+            ssize_t n = read(fd, buffer, size);
+            if (n <= 0) {
+                return false;
+            }
+            buffer += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    static bool writeFully(int fd, const char *buffer, size_t size) {
+        while (size > 0) {
+            ssize_t n = write(fd, buffer, size);
+            if (n <= 0) {
+                return false;
+            }
+            buffer += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    static bool readFrame(int fd, std::string &payload) {
+        uint32_t length;
+        if (!readFully(fd, (char *)&length, sizeof(length))) {
+            return false;
+        }
+        length = ntohl(length);
+        if (length > MAX_FRAME) {
+            return false;
+        }
+        payload.assign(length, '\0');
+        return readFully(fd, &payload[0], length);
+    }
+
+    static bool writeFrame(int fd, const std::string &payload) {
+        uint32_t length = htonl(payload.size());
+        return writeFully(fd, (const char *)&length, sizeof(length)) && writeFully(fd, payload.data(), payload.size());
+    }
+
+    static std::unordered_map<std::string, std::string> parseRequest(const std::string &payload) {
+        std::unordered_map<std::string, std::string> request;
+        std::istringstream lines(payload);
+        std::string line;
+        while (std::getline(lines, line)) {
+            if (line.empty() || line[0] == '#') {
+                continue;
+            }
+            std::istringstream iss(line);
+            std::string key, value;
+            std::getline(iss, key, ':');
+            std::getline(iss, value);
+            trim(key);
+            trim(value);
+            if (!key.empty()) {
+                request[key] = value;
+            }
+        }
+        return request;
+    }
+
+    std::shared_ptr<SearchContext> findContext(const std::string &id) {
+        std::lock_guard<std::mutex> lock(contextsMutex);
+        auto found = contexts.find(id);
+        return found == contexts.end() ? nullptr : found->second;
+    }
+
+    std::string load(const std::string &id, std::unordered_map<std::string, std::string> &request) {
+        Config config = baseConfig;
+        FileManager::applyConfigMap(config, request);
+        std::shared_ptr<SearchContext> context = findContext(id);
+        if (!context) {
+            context = std::make_shared<SearchContext>();
+        }
+        auto loadStart = std::chrono::steady_clock::now();
+        if (context->load(config) != 0) {
+            return error("Cannot read trajectory: " + config.trajectoryFilename);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - loadStart;
+        {
+            std::lock_guard<std::mutex> lock(contextsMutex);
+            contexts[id] = context;
+        }
+        std::shared_ptr<const Trajectory> trajectory = context->trajectory();
+        debug("[Serve] [Loaded]: ", id, " [Frames]: ", trajectory->frames, " [Seconds]: ", elapsed.count());
+        std::ostringstream oss;
+        oss << "{\"status\": \"ok\", \"id\": " << FileManager::jsonString(id)
+            << ", \"frames\": " << trajectory->frames
+            << ", \"atoms\": " << trajectory->atoms
+            << ", \"spheres\": " << trajectory->spheres
+            << ", \"loadSeconds\": " << elapsed.count() << "}";
+        return oss.str();
+    }
+
+    std::string search(const std::string &id, std::unordered_map<std::string, std::string> &request) {
+        std::shared_ptr<SearchContext> context = findContext(id);
+        if (!context) {
+            return error("Unknown trajectory id: " + id);
+        }
+        Config config = baseConfig;
+        FileManager::applyConfigMap(config, request);
+        if (!strategyNameValid(config.searchStrategy)) {
+            return error("Unknown search strategy: " + config.searchStrategy);
+        }
+        if (!sphereRadiiError(config).empty()) {
+            return error(sphereRadiiError(config));
+        }
+        config.writeAsCSV = false;
+        config.writeAsJSON = false;
+        config.showDebugCurrentBest = false;
+        config.showDebugRouteBest = false;
+
+        // caches which existed before this query
+        bool indexWarm = false;
+        context->fingerprintIndex(config, &indexWarm);
+        size_t cachedPairs = 0, cachedAllocations = 0;
+        std::shared_ptr<ResidentCache> cache = context->residentCache(config);
+        if (cache) {
+            cache->sizes(cachedPairs, cachedAllocations);
+        }
+
+        int threads = budget.acquire(config.ompThreads > 0 ? config.ompThreads : budget.total);
+        config.ompThreads = threads;
+        SearchStats stats = context->search(config);
+        budget.release(threads);
+
+        std::ostringstream oss;
+        oss << "{\"status\": \"ok\", \"id\": " << FileManager::jsonString(id)
+            << ", \"best\": {\"i\": " << stats.best.i << ", \"j\": " << stats.best.j << ", \"rmsd\": " << stats.best.rmsdValue << "}"
+            << ", \"topK\": [";
+        for (size_t k = 0; k < stats.topPairs.size(); k++) {
+            oss << (k ? ", " : "") << "{\"i\": " << stats.topPairs[k].i << ", \"j\": " << stats.topPairs[k].j
+                << ", \"rmsd\": " << stats.topPairs[k].rmsdValue << "}";
+        }
+        oss << "], \"elapsedTime\": " << stats.elapsedSeconds
+            << ", \"timeToBest\": " << stats.timeToBest
+            << ", \"threads\": " << threads
+            << ", \"rmsdCalculations\": " << stats.rmsdCalculations
+            << ", \"allocations\": " << stats.allocations
+            << ", \"cache\": {\"enabled\": " << (cache ? "true" : "false")
+            << ", \"pairsBefore\": " << cachedPairs
+            << ", \"allocationsBefore\": " << cachedAllocations
+            << ", \"valueLookups\": " << stats.valueLookups
+            << ", \"valueHits\": " << stats.valueHits
+            << ", \"valueHitRate\": " << (stats.valueLookups ? (double)stats.valueHits / stats.valueLookups : 0.0)
+            << ", \"allocationLookups\": " << stats.allocationLookups
+            << ", \"allocationHits\": " << stats.allocationHits
+            << ", \"allocationHitRate\": " << (stats.allocationLookups ? (double)stats.allocationHits / stats.allocationLookups : 0.0)
+            << ", \"fingerprintIndexWarm\": " << (indexWarm ? "true" : "false") << "}}";
+        return oss.str();
+    }
+
+    std::string list() {
+        std::lock_guard<std::mutex> lock(contextsMutex);
+        std::ostringstream oss;
+        oss << "{\"status\": \"ok\", \"trajectories\": [";
+        bool first = true;
+        for (auto &entry : contexts) {
+            std::shared_ptr<const Trajectory> trajectory = entry.second->trajectory();
+            oss << (first ? "" : ", ") << "{\"id\": " << FileManager::jsonString(entry.first)
+                << ", \"frames\": " << trajectory->frames
+                << ", \"atoms\": " << trajectory->atoms
+                << ", \"searches\": " << entry.second->searches() << "}";
+            first = false;
+        }
+        oss << "]}";
+        return oss.str();
+    }
+
+    std::string handle(const std::string &payload) {
+        std::unordered_map<std::string, std::string> request = parseRequest(payload);
+        std::string command = request["command"];
+        std::string id = request["id"];
+        request.erase("command");
+        request.erase("id");
+        try {
+            if (command == "load") {
+                return load(id, request);
+            } else if (command == "search") {
+                return search(id, request);
+            } else if (command == "cancel" || command == "unload") {
+                std::shared_ptr<SearchContext> context = findContext(id);
+                if (!context) {
+                    return error("Unknown trajectory id: " + id);
+                }
+                context->cancel();
+                if (command == "unload") {
+                    std::lock_guard<std::mutex> lock(contextsMutex);
+                    contexts.erase(id);
+                }
+                return "{\"status\": \"ok\", \"id\": " + FileManager::jsonString(id) + "}";
+            } else if (command == "list") {
+                return list();
+            } else if (command == "shutdown") {
+                stop();
+                return "{\"status\": \"ok\"}";
+            }
+        } catch (const std::exception &e) {
+            return error(e.what());
+        }
+        return error("Unknown command: " + command);
+    }
+
+    void serveConnection(int fd) {
+        std::string payload;
+        while (readFrame(fd, payload)) {
+            if (!writeFrame(fd, handle(payload))) {
+                break;
+            }
+        }
+        close(fd);
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        connections.erase(fd);
+        connectionsDone.notify_all();
+    }
+
+    // refusing new connections, cancelling running searches and closing idle connections
+    void stop() {
+        if (stopping.exchange(true)) {
+            return;
+        }
+        shutdown(listenSocket, SHUT_RDWR);
+        {
+            std::lock_guard<std::mutex> lock(contextsMutex);
+            for (auto &entry : contexts) {
+                entry.second->cancel();
+            }
+        }
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        for (int fd : connections) {
+            shutdown(fd, SHUT_RD);
+        }
+    }
+
+  public:
+    SearchServer(const Config &config)
+        : baseConfig(config), budget(config.serveThreads > 0 ? config.serveThreads : omp_get_num_procs()), listenSocket(-1), stopping(false) {
+        baseConfig.residentCache = true;
+    }
+
+    // serving until a shutdown request, returns 0 on clean exit
+    int run() {
+        const std::string &path = baseConfig.serveSocket;
+        sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) {
+            std::cout << "Socket path too long: " << path << std::endl;
+            return 1;
+        }
+        strcpy(address.sun_path, path.c_str());
+        listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+        unlink(path.c_str());
+        if (listenSocket < 0 || bind(listenSocket, (sockaddr *)&address, sizeof(address)) != 0 || listen(listenSocket, 16) != 0) {
+            std::cout << "Cannot listen on socket: " << path << " (" << strerror(errno) << ")" << std::endl;
+            return 1;
+        }
+        debug("[Serve] [Socket]: ", path, " [Threads]: ", budget.total);
+
+        while (!stopping) {
+            int fd = accept(listenSocket, nullptr, nullptr);
+            if (fd < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            std::lock_guard<std::mutex> lock(connectionsMutex);
+            if (stopping) {
+                close(fd);
+                break;
+            }
+            connections.insert(fd);
+            std::thread(&SearchServer::serveConnection, this, fd).detach();
+        }
+
+        std::unique_lock<std::mutex> lock(connectionsMutex);
+        connectionsDone.wait(lock, [this] { return connections.empty(); });
+        close(listenSocket);
+        unlink(path.c_str());
+        debug("[Serve] [Stopped]");
+        return 0;
+    }
+};
+
+#endif // SEARCH_SERVER_H
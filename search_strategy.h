@@ -0,0 +1,471 @@
+#ifndef SEARCH_STRATEGY_H
+#define SEARCH_STRATEGY_H
+
+#include <cmath>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <omp.h>
+
+#include "evaluator.h"
+#include "globals.h"
+
+// One route of a search, started at pair (i, j) and returning the best pair found on that route.
+// Every thread owns its strategy objects, so strategies may keep per-thread state between routes.
+class SearchStrategy {
+  protected:
+    Evaluator &ev;
+    int allocatedNow;
+
+    // allocating atoms only if allocation frame changed since the last evaluation,
+    // threshold is the value to beat used by coarse screening
+    inline double evaluate(int allocatedOnFrame, int changingFrame, double threshold = -1) {
+        if (allocatedOnFrame != allocatedNow) {
+            ev.rmsd.atomsAllocation(allocatedOnFrame);
+            allocatedNow = allocatedOnFrame;
+        }
+        return ev.rmsd.calculateRMSDSuperpose(changingFrame, threshold);
+    }
+
+    inline double randomUnit() {
+        return (double)nextRandom() / RAND_MAX;
+    }
+
+    // frame moved by random offset from [-range, range] \ {0}, clamped to the matrix
+    inline int neighbourFrame(int frame, int range) {
+        int offset = getRandom(1, range) * (getRandom(0, 1) * 2 - 1);
+        int moved = frame + offset;
+        if (!ev.insideMatrixBoundaries(moved)) {
+            moved = frame - offset;
+        }
+        return std::min(std::max(moved, ev.config.frameFrom), ev.config.frameFrom + ev.matrixSize() - 1);
+    }
+
+    inline int neighbourhoodRange() {
+        return std::max(1, ev.matrixSize() / 20);
+    }
+
+  public:
+    SearchStrategy(Evaluator &ev) : ev(ev), allocatedNow(-1) {}
+    virtual ~SearchStrategy() {}
+    virtual LocalSearchResult route(int i, int j) = 0;
+};
+
+// Original local search: walking straight along changing frame while improving,
+// switching sides, jumping from local area and changing allocations.
+class LocalSearchStrategy : public SearchStrategy {
+  public:
+    LocalSearchStrategy(Evaluator &ev) : SearchStrategy(ev) {}
+
+    inline double changeAllocationsAndCalculate(int &allocatedOnFrame, int &changingFrame, double routeBestValue) {
+        if (getRandom(1, 100) <= ev.config.randomFrameWhileSwappingChance * 100) {
+            // (A, B) -> (C, D)
+            int new_i = ev.randomFrame();
+            int new_j = ev.randomFrame();
+            while (new_i == allocatedOnFrame || new_i == changingFrame) {
+                new_i = ev.randomFrame();
+            }
+            while (new_j == allocatedOnFrame || new_j == changingFrame || new_j == new_i) {
+                new_j = ev.randomFrame();
+            }
+            allocatedOnFrame = new_i;
+            changingFrame = new_j;
+            ev.rmsd.atomsAllocation(allocatedOnFrame);
+
+            return ev.rmsd.calculateRMSDSuperpose(changingFrame, routeBestValue);
+        }
+        // (A, B) -> (B, C)
+        int new_j = ev.randomFrame();
+        while (new_j == allocatedOnFrame || new_j == changingFrame) {
+            new_j = ev.randomFrame();
+        }
+        allocatedOnFrame = changingFrame;
+        changingFrame = new_j;
+        ev.rmsd.atomsAllocation(allocatedOnFrame);
+        return ev.rmsd.calculateRMSDSuperpose(changingFrame, routeBestValue);
+    }
+
+    bool jump(int &allocatedOnFrame, int &changingFrame, LocalSearchResult &routeBest) {
+        int new_j = ev.jumpTarget(allocatedOnFrame);
+
+        while (new_j == allocatedOnFrame || new_j == changingFrame) {
+            new_j = ev.randomFrame();
+        }
+
+        double newValue = ev.rmsd.calculateRMSDSuperpose(new_j, routeBest.rmsdValue);
+
+        if (ev.saveIfRouteBest(routeBest, newValue, allocatedOnFrame, new_j)) {
+            changingFrame = new_j;
+            return true;
+        }
+        return false;
+    }
+
+    LocalSearchResult route(int i, int j) override {
+        // traversing route: i != j checked
+        int allocatedOnFrame = i;
+        int changingFrame = j;
+        ev.rmsd.atomsAllocation(allocatedOnFrame);
+        LocalSearchResult routeBest = {
+            ev.rmsd.calculateRMSDSuperpose(changingFrame),
+            allocatedOnFrame,
+            changingFrame,
+        };
+        ev.topK.offer(omp_thread_id, routeBest.rmsdValue, allocatedOnFrame, changingFrame);
+
+        bool changedSidesAlready = false;
+        int step = getRandom(0, 1) * 2 - 1; // -1 or +1
+
+        while (true) {
+            if (ev.timeExceeded()) {
+                return routeBest;
+            }
+
+            int newChangingFrame = changingFrame + step;
+            if (!ev.identifiersGood(allocatedOnFrame, newChangingFrame)) {
+                // changing direction
+                if (!changedSidesAlready) {
+                    step *= -1;
+                    changedSidesAlready = true;
+                    continue;
+                }
+                step = getRandom(0, 1) * 2 - 1; // -1 or +1
+                changedSidesAlready = false;
+                // otherwise, try to jump
+                if (getRandom(1, 100) <= ev.config.jumpFromLocalAreaChance * 100 && jump(allocatedOnFrame, changingFrame, routeBest)) {
+                    // jump
+                    continue;
+                }
+                // otherwise, no jump, change allocations
+                double newValue = changeAllocationsAndCalculate(allocatedOnFrame, changingFrame, routeBest.rmsdValue);
+
+                if (ev.saveIfRouteBest(routeBest, newValue, allocatedOnFrame, changingFrame)) {
+                    continue;
+                } else {
+                    return routeBest;
+                }
+            }
+
+            double newValue = ev.rmsd.calculateRMSDSuperpose(newChangingFrame, routeBest.rmsdValue);
+            if (ev.saveIfRouteBest(routeBest, newValue, allocatedOnFrame, newChangingFrame)) {
+                // better than current best
+                // going in straight line from now on
+                changingFrame = newChangingFrame;
+                while (true) {
+                    if (ev.timeExceeded()) {
+                        return routeBest;
+                    }
+                    newChangingFrame = changingFrame + step;
+                    if (!ev.identifiersGood(allocatedOnFrame, newChangingFrame)) {
+                        break;
+                    }
+                    newValue = ev.rmsd.calculateRMSDSuperpose(newChangingFrame, routeBest.rmsdValue);
+
+                    if (ev.saveIfRouteBest(routeBest, newValue, allocatedOnFrame, newChangingFrame)) {
+                        changingFrame = newChangingFrame;
+                        continue;
+                    } else {
+                        break;
+                    }
+                }
+                // cannot go straight line anymore
+                // cannot change direction because we came from there
+                // trying to jump
+                step = getRandom(0, 1) * 2 - 1; // -1 or +1
+                changedSidesAlready = false;
+                if (getRandom(1, 100) <= ev.config.jumpFromLocalAreaChance * 100 && jump(allocatedOnFrame, changingFrame, routeBest)) {
+                    // jump
+                    continue;
+                }
+                // otherwise, no jump, change allocations
+                double newValue = changeAllocationsAndCalculate(allocatedOnFrame, changingFrame, routeBest.rmsdValue);
+
+                if (ev.saveIfRouteBest(routeBest, newValue, allocatedOnFrame, changingFrame)) {
+                    continue;
+                } else {
+                    return routeBest;
+                }
+            }
+
+            // not better
+            // trying to change sides
+            if (!changedSidesAlready) {
+                step *= -1;
+                changedSidesAlready = true;
+                continue;
+            }
+
+            // cannot change directions
+            step = getRandom(0, 1) * 2 - 1; // -1 or +1
+            changedSidesAlready = false;
+            // otherwise, try to jump
+            if (getRandom(1, 100) <= ev.config.jumpFromLocalAreaChance * 100 && jump(allocatedOnFrame, changingFrame, routeBest)) {
+                // jump
+                continue;
+            }
+            // otherwise, no jump, change allocations
+            newValue = changeAllocationsAndCalculate(allocatedOnFrame, changingFrame, routeBest.rmsdValue);
+
+            if (ev.saveIfRouteBest(routeBest, newValue, allocatedOnFrame, changingFrame)) {
+                continue;
+            } else {
+                return routeBest;
+            }
+        }
+    }
+};
+
+// Simulated annealing over (allocation, frame) moves. Worse pairs are accepted with probability
+// exp(delta / T), T starts at annealingTemperature times the starting value and is multiplied by
+// annealingCooling after every move. Route ends when T drops below 0.001 of its starting value.
+class AnnealingStrategy : public SearchStrategy {
+  public:
+    AnnealingStrategy(Evaluator &ev) : SearchStrategy(ev) {}
+
+    LocalSearchResult route(int i, int j) override {
+        allocatedNow = -1;
+        int allocatedOnFrame = i;
+        int changingFrame = j;
+        double current = evaluate(allocatedOnFrame, changingFrame);
+        LocalSearchResult routeBest = {
+            current,
+            allocatedOnFrame,
+            changingFrame,
+        };
+        ev.topK.offer(omp_thread_id, current, allocatedOnFrame, changingFrame);
+
+        double temperature = ev.config.annealingTemperature * std::max(current, 1e-9);
+        double minTemperature = temperature * 1e-3;
+        int range = neighbourhoodRange();
+
+        while (temperature > minTemperature && !ev.timeExceeded()) {
+            int newAllocatedOnFrame = allocatedOnFrame;
+            int newChangingFrame = changingFrame;
+            int move = getRandom(1, 100);
+            if (move <= ev.config.randomFrameWhileSwappingChance * 100) {
+                // (A, B) -> (C, D)
+                ev.choosePairRandom(newAllocatedOnFrame, newChangingFrame);
+            } else if (move <= (ev.config.randomFrameWhileSwappingChance + ev.config.jumpFromLocalAreaChance) * 100) {
+                // (A, B) -> (A, C)
+                newChangingFrame = ev.jumpTarget(allocatedOnFrame);
+            } else if (move % 10 == 0) {
+                // (A, B) -> (A', B)
+                newAllocatedOnFrame = neighbourFrame(allocatedOnFrame, range);
+            } else {
+                // (A, B) -> (A, B')
+                newChangingFrame = neighbourFrame(changingFrame, range);
+            }
+            if (newAllocatedOnFrame == newChangingFrame) {
+                continue;
+            }
+
+            // pairs worse than current by more than 3T are accepted with probability below 5%
+            double newValue = evaluate(newAllocatedOnFrame, newChangingFrame, current - 3 * temperature);
+            temperature *= ev.config.annealingCooling;
+            if (newValue < 0) {
+                // pair in memory
+                continue;
+            }
+            ev.saveIfRouteBest(routeBest, newValue, newAllocatedOnFrame, newChangingFrame);
+            double delta = newValue - current;
+            if (delta >= 0 || randomUnit() < std::exp(delta / temperature)) {
+                current = newValue;
+                allocatedOnFrame = newAllocatedOnFrame;
+                changingFrame = newChangingFrame;
+            }
+        }
+        return routeBest;
+    }
+};
+
+// Tabu search over (allocation, frame) moves. Every iteration evaluates tabuCandidates neighbours
+// (one of them on a different allocation frame) and moves to the best one that is not tabu,
+// even if it is worse. Visited pairs stay tabu for tabuTenure iterations, unless they beat route best.
+// Route ends after tabuPatience iterations without route best improvement.
+class TabuStrategy : public SearchStrategy {
+  private:
+    std::deque<std::pair<int, int>> tabuList;
+
+    bool isTabu(int i, int j) {
+        for (const auto &p : tabuList) {
+            if (p.first == i && p.second == j) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+  public:
+    TabuStrategy(Evaluator &ev) : SearchStrategy(ev) {}
+
+    LocalSearchResult route(int i, int j) override {
+        allocatedNow = -1;
+        tabuList.clear();
+        int allocatedOnFrame = i;
+        int changingFrame = j;
+        LocalSearchResult routeBest = {
+            evaluate(allocatedOnFrame, changingFrame),
+            allocatedOnFrame,
+            changingFrame,
+        };
+        ev.topK.offer(omp_thread_id, routeBest.rmsdValue, allocatedOnFrame, changingFrame);
+
+        int range = neighbourhoodRange();
+        int candidates = std::max(ev.config.tabuCandidates, 1);
+        int withoutImprovement = 0;
+
+        while (withoutImprovement < ev.config.tabuPatience && !ev.timeExceeded()) {
+            LocalSearchResult chosen;
+            bool improved = false;
+            // moves on current allocation go first, allocation change is the last candidate
+            for (int c = 0; c < candidates && !ev.timeExceeded(); c++) {
+                int newAllocatedOnFrame = allocatedOnFrame;
+                int newChangingFrame = changingFrame;
+                if (c == candidates - 1 && candidates > 1) {
+                    newAllocatedOnFrame = neighbourFrame(allocatedOnFrame, range);
+                } else if (getRandom(1, 100) <= ev.config.jumpFromLocalAreaChance * 100) {
+                    newChangingFrame = ev.jumpTarget(allocatedOnFrame);
+                } else {
+                    newChangingFrame = neighbourFrame(changingFrame, range);
+                }
+                if (newAllocatedOnFrame == newChangingFrame) {
+                    continue;
+                }
+                double newValue = evaluate(newAllocatedOnFrame, newChangingFrame, chosen.rmsdValue);
+                if (newValue < 0) {
+                    continue;
+                }
+                bool aspiration = newValue > routeBest.rmsdValue;
+                if (ev.saveIfRouteBest(routeBest, newValue, newAllocatedOnFrame, newChangingFrame)) {
+                    improved = true;
+                }
+                if ((aspiration || !isTabu(newAllocatedOnFrame, newChangingFrame)) && newValue > chosen.rmsdValue) {
+                    chosen = {newValue, newAllocatedOnFrame, newChangingFrame};
+                }
+            }
+            withoutImprovement = improved ? 0 : withoutImprovement + 1;
+            if (chosen.i < 0) {
+                continue;
+            }
+            tabuList.push_back({allocatedOnFrame, changingFrame});
+            while ((int)tabuList.size() > ev.config.tabuTenure) {
+                tabuList.pop_front();
+            }
+            allocatedOnFrame = chosen.i;
+            changingFrame = chosen.j;
+        }
+        return routeBest;
+    }
+};
+
+// Portfolio of strategies shared by threads of one search. After every route a thread records
+// how much its strategy improved the incumbent and how long the route took, and picks its next
+// strategy with probability proportional to the (decaying) improvement rate of each strategy.
+class Portfolio {
+  public:
+    static const int STRATEGIES = 3;
+
+  private:
+    double gain[STRATEGIES];
+    double seconds[STRATEGIES];
+    double totalSeconds[STRATEGIES];
+    int routes[STRATEGIES];
+    int improvements[STRATEGIES];
+    omp_lock_t portfolioMutex;
+
+  public:
+    Portfolio() {
+        omp_init_lock(&portfolioMutex);
+        reset();
+    }
+
+    ~Portfolio() {
+        omp_destroy_lock(&portfolioMutex);
+    }
+
+    void reset() {
+        for (int s = 0; s < STRATEGIES; s++) {
+            gain[s] = 0;
+            seconds[s] = 0;
+            totalSeconds[s] = 0;
+            routes[s] = 0;
+            improvements[s] = 0;
+        }
+    }
+
+    void record(int strategy, double improvement, double routeSeconds) {
+        omp_set_lock(&portfolioMutex);
+        for (int s = 0; s < STRATEGIES; s++) {
+            gain[s] *= 0.95;
+            seconds[s] *= 0.95;
+        }
+        gain[strategy] += improvement;
+        seconds[strategy] += routeSeconds;
+        totalSeconds[strategy] += routeSeconds;
+        routes[strategy]++;
+        if (improvement > 0) {
+            improvements[strategy]++;
+        }
+        omp_unset_lock(&portfolioMutex);
+    }
+
+    int choose() {
+        // exploring, so no strategy is abandoned for good
+        if (getRandom(1, 100) <= 10) {
+            return getRandom(0, STRATEGIES - 1);
+        }
+        double rate[STRATEGIES];
+        double rateSum = 0;
+        omp_set_lock(&portfolioMutex);
+        for (int s = 0; s < STRATEGIES; s++) {
+            rate[s] = (gain[s] + 1e-6) / (seconds[s] + 1e-3);
+            rateSum += rate[s];
+        }
+        omp_unset_lock(&portfolioMutex);
+        double r = (double)nextRandom() / RAND_MAX * rateSum;
+        for (int s = 0; s < STRATEGIES; s++) {
+            r -= rate[s];
+            if (r <= 0) {
+                return s;
+            }
+        }
+        return STRATEGIES - 1;
+    }
+
+    void print() {
+        double sum = 0;
+        for (int s = 0; s < STRATEGIES; s++) {
+            sum += totalSeconds[s];
+        }
+        for (int s = 0; s < STRATEGIES; s++) {
+            ::print("   ", strategyName(s), ": ", sum > 0 ? totalSeconds[s] / sum * 100 : 0, "% of time, ",
+                    routes[s], " routes, ", improvements[s], " improvements");
+        }
+    }
+
+    static const char *strategyName(int strategy) {
+        static const char *names[STRATEGIES] = {"localSearch", "annealing", "tabu"};
+        return names[strategy];
+    }
+};
+
+// returns nullptr for unknown name, "portfolio" is not a single strategy
+inline std::unique_ptr<SearchStrategy> createStrategy(const std::string &name, Evaluator &ev) {
+    if (name == "localSearch") {
+        return std::unique_ptr<SearchStrategy>(new LocalSearchStrategy(ev));
+    } else if (name == "annealing") {
+        return std::unique_ptr<SearchStrategy>(new AnnealingStrategy(ev));
+    } else if (name == "tabu") {
+        return std::unique_ptr<SearchStrategy>(new TabuStrategy(ev));
+    }
+    return nullptr;
+}
+
+inline bool strategyNameValid(const std::string &name) {
+    return name == "localSearch" || name == "annealing" || name == "tabu" || name == "portfolio";
+}
+
+#endif // SEARCH_STRATEGY_H
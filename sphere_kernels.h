@@ -0,0 +1,259 @@
+#ifndef SPHERE_KERNELS_H
+#define SPHERE_KERNELS_H
+
+#include <cmath>
+#include <vector>
+#include <eigen3/Eigen/Dense>
+
+#include "coordinate_store.h"
+
+// Sphere RMSD kernels specialised for compile-time maximum sphere size MAX.
+// Atoms are gathered into fixed size arrays padded with zeros, and every loop runs MAX times
+// with padded atoms masked out, so the compiler can fully unroll and vectorise them.
+// The result is the same as superposing frame two onto frame one with Find3DAffineTransform
+// (rotation, translation and scale from consecutive atom distances), but the RMSD is taken
+// in closed form from centered sums and the singular values of the 3x3 covariance matrix.
+// View is CoordinateStore::FrameView or QuantisedFrameView, quantised coordinates are decoded in the gather.
+template <int MAX, typename View>
+double sphereRMSDFixed(const std::vector<int> &atoms, View frame1, View frame2) {
+    int n = atoms.size();
+    // a - frame one, b - frame two
+    double a[3][MAX];
+    double b[3][MAX];
+    double mask[MAX];
+    for (int j = 0; j < MAX; j++) {
+        bool inside = j < n;
+        int atom = inside ? atoms[j] : atoms[0];
+        mask[j] = inside ? 1.0 : 0.0;
+        for (int k = 0; k < 3; k++) {
+            a[k][j] = frame1.coordinate(atom, k) * mask[j];
+            b[k][j] = frame2.coordinate(atom, k) * mask[j];
+        }
+    }
+
+    // scale is the ratio of sums of distances between consecutive atoms
+    double distA = 0, distB = 0;
+    for (int j = 0; j < MAX - 1; j++) {
+        double da = 0, db = 0;
+        for (int k = 0; k < 3; k++) {
+            double ta = a[k][j + 1] - a[k][j];
+            double tb = b[k][j + 1] - b[k][j];
+            da += ta * ta;
+            db += tb * tb;
+        }
+        distA += std::sqrt(da) * mask[j + 1];
+        distB += std::sqrt(db) * mask[j + 1];
+    }
+
+    double ca[3] = {0, 0, 0};
+    double cb[3] = {0, 0, 0};
+    for (int j = 0; j < MAX; j++) {
+        for (int k = 0; k < 3; k++) {
+            ca[k] += a[k][j];
+            cb[k] += b[k][j];
+        }
+    }
+    for (int k = 0; k < 3; k++) {
+        ca[k] /= n;
+        cb[k] /= n;
+    }
+
+    double saa = 0, sbb = 0, sab = 0;
+    Eigen::Matrix3d H = Eigen::Matrix3d::Zero();
+    for (int j = 0; j < MAX; j++) {
+        double pa[3], pb[3];
+        for (int k = 0; k < 3; k++) {
+            pa[k] = (a[k][j] - ca[k]) * mask[j];
+            pb[k] = (b[k][j] - cb[k]) * mask[j];
+            saa += pa[k] * pa[k];
+            sbb += pb[k] * pb[k];
+            sab += (a[k][j] - b[k][j]) * (a[k][j] - b[k][j]);
+        }
+        for (int k = 0; k < 3; k++) {
+            for (int l = 0; l < 3; l++) {
+                H(k, l) += pb[k] * pa[l];
+            }
+        }
+    }
+
+    if (distA <= 0 || distB <= 0) {
+        // no transformation
+        return std::sqrt(sab / (n * 3.0));
+    }
+    double scale = distA / distB;
+
+    Eigen::JacobiSVD<Eigen::Matrix3d> svd(H, Eigen::ComputeFullU | Eigen::ComputeFullV);
+    Eigen::Vector3d sv = svd.singularValues();
+    double d = (svd.matrixV() * svd.matrixU().transpose()).determinant() > 0 ? 1.0 : -1.0;
+    double traceRH = sv(0) + sv(1) + d * sv(2);
+
+    double squares = scale * scale * sbb + saa - 2 * scale * traceRH;
+    return std::sqrt(std::max(squares, 0.0) / (n * 3.0));
+}
+
+// the smallest bucket the sphere fits in, 0 if it needs the dynamic path
+inline int sphereBucket(int atomsInSphere) {
+    if (atomsInSphere <= 32) {
+        return 32;
+    } else if (atomsInSphere <= 64) {
+        return 64;
+    } else if (atomsInSphere <= 128) {
+        return 128;
+    } else if (atomsInSphere <= 256) {
+        return 256;
+    }
+    return 0;
+}
+
+// returns -1.0 if sphere is too big for every bucket
+template <typename View>
+inline double sphereRMSDBucketed(const std::vector<int> &atoms, View frame1, View frame2) {
+    switch (sphereBucket(atoms.size())) {
+    case 32:
+        return sphereRMSDFixed<32>(atoms, frame1, frame2);
+    case 64:
+        return sphereRMSDFixed<64>(atoms, frame1, frame2);
+    case 128:
+        return sphereRMSDFixed<128>(atoms, frame1, frame2);
+    case 256:
+        return sphereRMSDFixed<256>(atoms, frame1, frame2);
+    }
+    return -1.0;
+}
+
+// Sphere RMSD for several radii from one pass over the atoms of the largest one. atoms are in ascending order,
+// level of an atom is the index of the smallest radius it is within, so the sphere of radius r holds atoms
+// of levels 0..r. Centered sums and the covariance matrix are additive, so they are summed per level and
+// the sphere of radius r takes the prefix sum over levels 0..r. The scale term follows every radius'
+// own chain of consecutive atoms, so every value equals the value of a sphere allocated with that radius alone.
+// Coordinates are taken relative to the first atom, which RMSD after superposition does not depend on.
+const int MAX_RADII = 8;
+
+template <typename View>
+void sphereRMSDRadii(const std::vector<int> &atoms, const std::vector<unsigned char> &levels, int radii, View frame1, View frame2,
+                     double *result) {
+    struct Sums {
+        int n;
+        double a[3], b[3];
+        double aa, bb, ab;
+        double ba[3][3];
+    };
+    Sums sums[MAX_RADII] = {};
+    double distA[MAX_RADII] = {}, distB[MAX_RADII] = {};
+    double previous[MAX_RADII * 6];
+    // index of the previous atom of every radius, -1 before the first one
+    int previousAtom[MAX_RADII];
+    for (int r = 0; r < radii; r++) {
+        previousAtom[r] = -1;
+    }
+    if (atoms.empty()) {
+        for (int r = 0; r < radii; r++) {
+            result[r] = 0;
+        }
+        return;
+    }
+    double originA[3], originB[3];
+    for (int k = 0; k < 3; k++) {
+        originA[k] = frame1.coordinate(atoms[0], k);
+        originB[k] = frame2.coordinate(atoms[0], k);
+    }
+    for (size_t j = 0; j < atoms.size(); j++) {
+        double a[3], b[3];
+        double ab = 0;
+        for (int k = 0; k < 3; k++) {
+            double rawA = frame1.coordinate(atoms[j], k);
+            double rawB = frame2.coordinate(atoms[j], k);
+            ab += (rawA - rawB) * (rawA - rawB);
+            a[k] = rawA - originA[k];
+            b[k] = rawB - originB[k];
+        }
+        Sums &s = sums[levels[j]];
+        s.n++;
+        s.ab += ab;
+        for (int k = 0; k < 3; k++) {
+            s.a[k] += a[k];
+            s.b[k] += b[k];
+            s.aa += a[k] * a[k];
+            s.bb += b[k] * b[k];
+            for (int l = 0; l < 3; l++) {
+                s.ba[k][l] += b[k] * a[l];
+            }
+        }
+        // the atom follows the previous atom of every radius it is within; larger radii mostly share
+        // the previous atom, so the distance is calculated once for them
+        double da = 0, db = 0;
+        int shorterPrevious = -1;
+        for (int r = levels[j]; r < radii; r++) {
+            double *p = &previous[r * 6];
+            if (previousAtom[r] >= 0) {
+                if (r == levels[j] || previousAtom[r] != shorterPrevious) {
+                    da = 0;
+                    db = 0;
+                    for (int k = 0; k < 3; k++) {
+                        da += (a[k] - p[k]) * (a[k] - p[k]);
+                        db += (b[k] - p[3 + k]) * (b[k] - p[3 + k]);
+                    }
+                    da = std::sqrt(da);
+                    db = std::sqrt(db);
+                }
+                distA[r] += da;
+                distB[r] += db;
+            }
+            for (int k = 0; k < 3; k++) {
+                p[k] = a[k];
+                p[3 + k] = b[k];
+            }
+            shorterPrevious = previousAtom[r];
+            previousAtom[r] = j;
+        }
+    }
+
+    Sums total = {};
+    for (int r = 0; r < radii; r++) {
+        const Sums &s = sums[r];
+        total.n += s.n;
+        total.aa += s.aa;
+        total.bb += s.bb;
+        total.ab += s.ab;
+        for (int k = 0; k < 3; k++) {
+            total.a[k] += s.a[k];
+            total.b[k] += s.b[k];
+            for (int l = 0; l < 3; l++) {
+                total.ba[k][l] += s.ba[k][l];
+            }
+        }
+        int n = total.n;
+        if (n == 0) {
+            result[r] = 0;
+            continue;
+        }
+        if (distA[r] <= 0 || distB[r] <= 0) {
+            // no transformation
+            result[r] = std::sqrt(total.ab / (n * 3.0));
+            continue;
+        }
+        double ca[3], cb[3];
+        double saa = total.aa, sbb = total.bb;
+        for (int k = 0; k < 3; k++) {
+            ca[k] = total.a[k] / n;
+            cb[k] = total.b[k] / n;
+            saa -= n * ca[k] * ca[k];
+            sbb -= n * cb[k] * cb[k];
+        }
+        Eigen::Matrix3d H;
+        for (int k = 0; k < 3; k++) {
+            for (int l = 0; l < 3; l++) {
+                H(k, l) = total.ba[k][l] - n * cb[k] * ca[l];
+            }
+        }
+        double scale = distA[r] / distB[r];
+        Eigen::JacobiSVD<Eigen::Matrix3d> svd(H, Eigen::ComputeFullU | Eigen::ComputeFullV);
+        Eigen::Vector3d sv = svd.singularValues();
+        double d = (svd.matrixV() * svd.matrixU().transpose()).determinant() > 0 ? 1.0 : -1.0;
+        double traceRH = sv(0) + sv(1) + d * sv(2);
+        double squares = scale * scale * sbb + saa - 2 * scale * traceRH;
+        result[r] = std::sqrt(std::max(squares, 0.0) / (n * 3.0));
+    }
+}
+
+#endif // SPHERE_KERNELS_H
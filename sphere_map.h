@@ -0,0 +1,21 @@
+#ifndef SPHERE_MAP_H
+#define SPHERE_MAP_H
+
+#include <vector>
+
+// Local deviation of every sphere: RMSD of each sphere for the top pairs of a search,
+// and the largest RMSD every sphere reached over all pairs evaluated by the search.
+struct SphereMap {
+    // maxima[<sphere>], found on pair (maximaI[<sphere>], maximaJ[<sphere>]); -1 if never evaluated
+    std::vector<double> maxima;
+    std::vector<int> maximaI;
+    std::vector<int> maximaJ;
+    // pairs[<top pair>][<sphere>], in the order of top pairs
+    std::vector<std::vector<double>> pairs;
+
+    bool empty() const {
+        return maxima.empty();
+    }
+};
+
+#endif // SPHERE_MAP_H
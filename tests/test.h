@@ -0,0 +1,99 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "../globals.h"
+#include "../trajectory.h"
+
+// Minimal test harness: TEST(name) registers a test, CHECK and CHECK_NEAR count failures without stopping it.
+struct TestCase {
+    const char *name;
+    void (*run)();
+};
+
+std::vector<TestCase> &testCases();
+int &testFailures();
+
+struct TestRegistrar {
+    TestRegistrar(const char *name, void (*run)()) {
+        testCases().push_back({name, run});
+    }
+};
+
+#define TEST(name)                                              \
+    static void name();                                         \
+    static TestRegistrar name##Registrar(#name, name);          \
+    static void name()
+
+#define CHECK(condition)                                                                          \
+    do {                                                                                          \
+        if (!(condition)) {                                                                       \
+            std::cout << "  " << __FILE__ << ":" << __LINE__ << ": failed: " #condition << std::endl; \
+            testFailures()++;                                                                     \
+        }                                                                                         \
+    } while (0)
+
+// relative difference of a and b within tolerance
+#define CHECK_NEAR(a, b, tolerance)                                                                        \
+    do {                                                                                                   \
+        double checkA = (a), checkB = (b);                                                                 \
+        double scale = std::max(std::max(std::abs(checkA), std::abs(checkB)), 1.0);                        \
+        if (!(std::abs(checkA - checkB) <= (tolerance) * scale)) {                                         \
+            std::cout << "  " << __FILE__ << ":" << __LINE__ << ": " #a " = " << checkA << ", " #b " = " << checkB \
+                      << std::endl;                                                                        \
+            testFailures()++;                                                                              \
+        }                                                                                                  \
+    } while (0)
+
+// Chain of atoms about 1.5 angstroms apart with every fourth atom a CA, every frame is the first one
+// bent by a growing random displacement and moved by a rotation and translation.
+struct SyntheticTrajectory {
+    std::vector<double> coordinates;
+    std::shared_ptr<Trajectory> trajectory;
+
+    SyntheticTrajectory(int frames, int atoms, unsigned seed = 1) : coordinates((size_t)frames * atoms * 3) {
+        std::mt19937 random(seed);
+        std::normal_distribution<double> normal(0.0, 1.0);
+        std::vector<double> chain(atoms * 3, 0.0);
+        for (int a = 1; a < atoms; a++) {
+            double step[3], length = 0;
+            for (int k = 0; k < 3; k++) {
+                step[k] = normal(random) + (k == 0 ? 0.8 : 0.0);
+                length += step[k] * step[k];
+            }
+            length = std::sqrt(length);
+            for (int k = 0; k < 3; k++) {
+                // folding back every 40 atoms keeps the chain compact, so spheres hold a few dozen atoms
+                double direction = (a / 40) % 2 ? -1.0 : 1.0;
+                chain[a * 3 + k] = chain[(a - 1) * 3 + k] + 1.5 * step[k] / length * (k == 0 ? direction : 1.0);
+            }
+        }
+        for (int f = 0; f < frames; f++) {
+            double angle = 0.1 * f;
+            double shift[3] = {0.3 * f, -0.2 * f, 0.1 * f};
+            for (int a = 0; a < atoms; a++) {
+                double p[3];
+                for (int k = 0; k < 3; k++) {
+                    p[k] = chain[a * 3 + k] + normal(random) * 0.05 * f;
+                }
+                double *out = &coordinates[((size_t)f * atoms + a) * 3];
+                out[0] = std::cos(angle) * p[0] - std::sin(angle) * p[1] + shift[0];
+                out[1] = std::sin(angle) * p[0] + std::cos(angle) * p[1] + shift[1];
+                out[2] = p[2] + shift[2];
+            }
+        }
+        std::vector<int> CAAtoms;
+        for (int a = 0; a < atoms; a += 4) {
+            CAAtoms.push_back(a);
+        }
+        trajectory = std::make_shared<Trajectory>();
+        trajectory->borrow(coordinates.data(), frames, atoms, CAAtoms);
+    }
+};
+
+#endif // TEST_H
@@ -0,0 +1,78 @@
+#include <cstdio>
+#include <fstream>
+
+#include "../file_manager.h"
+#include "test.h"
+
+// ranges and lists of a batch file expand into the cartesian product of jobs, repeated runRepetitions times;
+// showLogs is one setting of the whole batch
+TEST(batchSweepsExpand) {
+    const char *filename = "tests/batch_test.yml";
+    {
+        std::ofstream file(filename);
+        file << "threads: 3\n"
+             << "# comment\n"
+             << "showLogs: false\n"
+             << "jumpFromLocalAreaChance: 0.05:0.15:0.05\n"
+             << "memorySize: 0, 0.1\n"
+             << "runRepetitions: 2\n";
+    }
+    bool showLogs = DEBUG;
+    DEBUG = true;
+    FileManager fileManager;
+    std::vector<Config> jobs;
+    int threads = 0;
+    CHECK(fileManager.readBatch(filename, jobs, threads));
+    std::remove(filename);
+    CHECK(!DEBUG);
+    DEBUG = showLogs;
+
+    CHECK(threads == 3);
+    CHECK(jobs.size() == 12);
+    double chances[] = {0.05, 0.1, 0.15};
+    double memorySizes[] = {0, 0.1};
+    for (size_t job = 0; job < jobs.size() && jobs.size() == 12; job++) {
+        CHECK_NEAR(jobs[job].jumpFromLocalAreaChance, chances[job / 4], 1e-12);
+        CHECK_NEAR(jobs[job].memorySize, memorySizes[job / 2 % 2], 1e-12);
+        CHECK(jobs[job].runRepetitions == 2);
+        CHECK(!jobs[job].showLogs);
+    }
+}
+
+// a written config reads back with every key, as the tuned config of --autotune is read with -c
+TEST(writtenConfigReadsBack) {
+    Config config;
+    config.initDefault();
+    config.trajectoryFilename = "a.pdb";
+    config.sphereRadius = 6.5;
+    config.sphereRadii = "4, 10";
+    config.coordinatePrecision = "int16";
+    config.frameFrom = 7;
+    config.matrixSize = 90;
+    config.searchStrategy = "tabu";
+    config.annealingCooling = 0.9;
+    config.tabuTenure = 12;
+    config.coarseScreening = true;
+    config.fingerprintPairs = 64;
+    config.jumpFromLocalAreaChance = 0.1;
+    config.showLogs = false;
+    std::stringstream stream;
+    FileManager::writeConfig(config, stream);
+    const char *filename = "tests/config_test.yml";
+    {
+        std::ofstream file(filename);
+        file << stream.str();
+    }
+    bool showLogs = DEBUG;
+    FileManager fileManager;
+    Config read;
+    CHECK(fileManager.readConfig(filename, read));
+    std::remove(filename);
+    DEBUG = showLogs;
+    std::stringstream readStream;
+    FileManager::writeConfig(read, readStream);
+    CHECK(readStream.str() == stream.str());
+    CHECK(read.trajectoryFilename == "a.pdb" && read.sphereRadii == "4, 10" && read.coordinatePrecision == "int16");
+    CHECK(read.sphereRadius == 6.5 && read.frameFrom == 7 && read.matrixSize == 90 && read.tabuTenure == 12);
+    CHECK(read.jumpFromLocalAreaChance == 0.1 && read.coarseScreening && !read.showLogs);
+}
@@ -0,0 +1,76 @@
+#include "../local_search_api.h"
+#include "test.h"
+
+// searches share the resident cache only if every setting their values depend on is the same
+TEST(residentCacheFollowsValueSettings) {
+    SyntheticTrajectory synthetic(6, 80);
+    SearchContext context;
+    context.load(std::shared_ptr<const Trajectory>(synthetic.trajectory));
+    Config config;
+    config.initDefault();
+    config.residentCache = true;
+    std::shared_ptr<ResidentCache> first = context.residentCache(config);
+    CHECK(first != nullptr);
+    CHECK(context.residentCache(config) == first);
+    // settings not changing values keep the cache
+    config.timeLimitMinutes *= 2;
+    config.topK += 1;
+    CHECK(context.residentCache(config) == first);
+
+    Config changed = config;
+    changed.fixedSizeKernels = !config.fixedSizeKernels;
+    std::shared_ptr<ResidentCache> kernels = context.residentCache(changed);
+    CHECK(kernels != first);
+    changed = config;
+    changed.sphereRadius += 1;
+    CHECK(context.residentCache(changed) != context.residentCache(config));
+    changed = config;
+    changed.coarseScreening = !config.coarseScreening;
+    CHECK(context.residentCache(changed) != context.residentCache(config));
+    config.coarseScreening = true;
+    std::shared_ptr<ResidentCache> coarse = context.residentCache(config);
+    changed = config;
+    changed.coarseMargin += 0.1;
+    CHECK(context.residentCache(changed) != coarse);
+    changed = config;
+    changed.coarseSpheres += 1;
+    CHECK(context.residentCache(changed) != context.residentCache(config));
+}
+
+// a search keeping sphere maxima calculates pairs the resident cache already holds, so maxima equal a cold run
+TEST(sphereMaximaWithWarmCache) {
+    SyntheticTrajectory synthetic(6, 200);
+    const Trajectory &trajectory = *synthetic.trajectory;
+    omp_thread_id = 0;
+    std::shared_ptr<ResidentCache> cache = std::make_shared<ResidentCache>(1000, 100);
+    RMSDCalculation warmUp(trajectory);
+    warmUp.cache = cache;
+    warmUp.initThreads(1, 0);
+
+    RMSDCalculation cold(trajectory);
+    cold.trackSpheres = true;
+    cold.initThreads(1, 0);
+    RMSDCalculation warm(trajectory);
+    warm.trackSpheres = true;
+    warm.cache = cache;
+    warm.initThreads(1, 0);
+    for (int i = 0; i < trajectory.frames; i++) {
+        warmUp.atomsAllocation(i);
+        cold.atomsAllocation(i);
+        warm.atomsAllocation(i);
+        for (int j = 0; j < trajectory.frames; j++) {
+            if (i != j) {
+                warmUp.calculateRMSDSuperpose(j);
+                CHECK_NEAR(warm.calculateRMSDSuperpose(j), cold.calculateRMSDSuperpose(j), 1e-12);
+            }
+        }
+    }
+    std::vector<double> coldValues, warmValues;
+    std::vector<int> coldI, coldJ, warmI, warmJ;
+    cold.sphereMaxima(coldValues, coldI, coldJ);
+    warm.sphereMaxima(warmValues, warmI, warmJ);
+    CHECK(coldValues == warmValues && coldI == warmI && coldJ == warmJ);
+    long lookups, hits, allocationLookups, allocationHits;
+    warm.cacheCounters(lookups, hits, allocationLookups, allocationHits);
+    CHECK(lookups == 0 && allocationHits > 0);
+}
@@ -0,0 +1,49 @@
+#include <cstdio>
+#include <fstream>
+#include <thread>
+
+#include "../trajectory_follower.h"
+#include "test.h"
+
+// a background load whose first frame is much longer than the rest estimates too few frames from the file size;
+// frames without room are counted, so every frame of the file is either read or dropped
+TEST(droppedFramesCounted) {
+    const char *filename = "tests/follower_test.pdb";
+    const int frames = 30;
+    {
+        std::ofstream file(filename);
+        char line[96];
+        for (int f = 0; f < frames; f++) {
+            file << "MODEL     " << f + 1 << "\n";
+            for (int r = 0; f == 0 && r < 2000; r++) {
+                file << "REMARK padding of the first frame, so the file size suggests fewer frames\n";
+            }
+            for (int a = 0; a < 8; a++) {
+                snprintf(line, sizeof(line), "ATOM  %5d  CA  ALA A%4d    %8.3f%8.3f%8.3f\n", a + 1, a + 1, 3.8 * a, 0.1 * f, 0.2 * a * f);
+                file << line;
+            }
+            file << "ENDMDL\n";
+        }
+    }
+    Config config;
+    config.initDefault();
+    config.trajectoryFilename = filename;
+    config.streamLoad = true;
+    bool showLogs = DEBUG;
+    DEBUG = false;
+    std::shared_ptr<Trajectory> trajectory = std::make_shared<Trajectory>();
+    {
+        TrajectoryFollower follower(trajectory);
+        CHECK(follower.open(config) == 0);
+        while (!follower.complete()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        CHECK(follower.capacityReached());
+    }
+    DEBUG = showLogs;
+    std::remove(filename);
+    CHECK(trajectory->available == trajectory->A.size());
+    CHECK(trajectory->framesDropped > 0);
+    CHECK(trajectory->available + trajectory->framesDropped == frames);
+    CHECK(trajectory->loadSeconds > 0);
+}
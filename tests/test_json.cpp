@@ -0,0 +1,13 @@
+#include "../file_manager.h"
+#include "test.h"
+
+// strings written into JSON results keep quotes, backslashes and control characters escaped
+TEST(jsonStringsEscaped) {
+    CHECK(FileManager::jsonString("traj.pdb") == "\"traj.pdb\"");
+    CHECK(FileManager::jsonString("") == "\"\"");
+    CHECK(FileManager::jsonString("name \"CA\"") == "\"name \\\"CA\\\"\"");
+    CHECK(FileManager::jsonString("C:\\runs\\a.pdb") == "\"C:\\\\runs\\\\a.pdb\"");
+    CHECK(FileManager::jsonString("a\nb\tc\rd") == "\"a\\nb\\tc\\rd\"");
+    CHECK(FileManager::jsonString(std::string("a\x01" "b\x1f", 4)) == "\"a\\u0001b\\u001f\"");
+    CHECK(FileManager::jsonString("\xc3\xa9") == "\"\xc3\xa9\"");
+}
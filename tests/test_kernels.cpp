@@ -0,0 +1,42 @@
+#include "../RMSD_calculation.h"
+#include "test.h"
+
+// pair values with fixed size kernels equal the Find3DAffineTransform path
+TEST(fixedSizeKernelsMatchDynamicPath) {
+    SyntheticTrajectory synthetic(12, 400);
+    const Trajectory &trajectory = *synthetic.trajectory;
+    omp_thread_id = 0;
+    RMSDCalculation fixed(trajectory), dynamic(trajectory);
+    fixed.fixedSizeKernels = true;
+    dynamic.fixedSizeKernels = false;
+    fixed.initThreads(1, 0);
+    dynamic.initThreads(1, 0);
+    for (int i = 0; i < trajectory.frames; i += 3) {
+        fixed.atomsAllocation(i);
+        dynamic.atomsAllocation(i);
+        for (int j = 0; j < trajectory.frames; j++) {
+            if (i != j) {
+                CHECK_NEAR(fixed.calculateRMSDSuperpose(j), dynamic.calculateRMSDSuperpose(j), 1e-9);
+            }
+        }
+    }
+}
+
+// every sphere of the synthetic chain fits a bucket and holds a few atoms, so the comparison above runs the fixed size kernels
+TEST(syntheticSpheresFitBuckets) {
+    SyntheticTrajectory synthetic(1, 400);
+    const Trajectory &trajectory = *synthetic.trajectory;
+    for (int s = 0; s < trajectory.spheres; s++) {
+        int atoms = 0;
+        for (int a = 0; a < trajectory.atoms; a++) {
+            double distance2 = 0;
+            for (int k = 0; k < 3; k++) {
+                double d = trajectory.A.at(0, a, k) - trajectory.A.at(0, trajectory.sphereCA[s], k);
+                distance2 += d * d;
+            }
+            atoms += distance2 <= 8.0 * 8.0 ? 1 : 0;
+        }
+        CHECK(atoms >= 4);
+        CHECK(sphereBucket(atoms) > 0);
+    }
+}
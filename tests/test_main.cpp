@@ -0,0 +1,27 @@
+#include <iostream>
+
+#include "test.h"
+
+std::vector<TestCase> &testCases() {
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+int &testFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+int main() {
+    DEBUG = false;
+    int failedCases = 0;
+    for (const TestCase &test : testCases()) {
+        int before = testFailures();
+        test.run();
+        bool passed = testFailures() == before;
+        failedCases += passed ? 0 : 1;
+        std::cout << (passed ? "[PASS] " : "[FAIL] ") << test.name << std::endl;
+    }
+    std::cout << testCases().size() - failedCases << " of " << testCases().size() << " tests passed" << std::endl;
+    return failedCases == 0 ? 0 : 1;
+}
@@ -0,0 +1,21 @@
+#include <cerrno>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "../coordinate_store.h"
+#include "test.h"
+
+// a store with huge pages maps whole huge pages and unmaps all of them on release
+TEST(hugePageStoreUnmappedWhole) {
+    const size_t HUGE_PAGE = 2 * 1024 * 1024;
+    CoordinateStore store;
+    CHECK(store.allocate(10, 1000, "none", "transparent"));
+    CHECK(store.memoryBytes() == HUGE_PAGE);
+    char *address = (char *)store[0].base;
+    store.release();
+    // mincore fails with ENOMEM on every page not mapped any more, the last page of the rounded mapping included
+    std::vector<unsigned char> resident(1);
+    size_t page = sysconf(_SC_PAGESIZE);
+    CHECK(mincore(address, page, resident.data()) != 0 && errno == ENOMEM);
+    CHECK(mincore(address + HUGE_PAGE - page, page, resident.data()) != 0 && errno == ENOMEM);
+}
@@ -0,0 +1,39 @@
+#include "../RMSD_calculation.h"
+#include "test.h"
+
+// every decoded atom lies within maxError of the original one, every coordinate within step / 2
+TEST(quantisedCoordinatesWithinMaxError) {
+    SyntheticTrajectory synthetic(8, 300);
+    const Trajectory &trajectory = *synthetic.trajectory;
+    CoordinateStore quantised;
+    CHECK(quantised.quantiseFrom(trajectory.A));
+    CHECK(quantised.quantised());
+    for (int f = 0; f < trajectory.frames; f++) {
+        CHECK(quantised.maxError(f) > 0);
+        double worst = 0, worstCoordinate = 0;
+        for (int a = 0; a < trajectory.atoms; a++) {
+            double squared = 0;
+            for (int k = 0; k < 3; k++) {
+                double error = std::abs(quantised.at(f, a, k) - trajectory.A.at(f, a, k));
+                worstCoordinate = std::max(worstCoordinate, error);
+                squared += error * error;
+            }
+            worst = std::max(worst, std::sqrt(squared));
+        }
+        CHECK(worst <= quantised.maxError(f) * (1 + 1e-9));
+        CHECK(worstCoordinate <= quantised.maxError(f) / std::sqrt(3.0) * (1 + 1e-9));
+    }
+}
+
+// on the same spheres, pair values from int16 coordinates differ by at most the documented bound
+TEST(quantisedPairValuesWithinBound) {
+    SyntheticTrajectory synthetic(16, 400);
+    const Trajectory &trajectory = *synthetic.trajectory;
+    CoordinateStore quantised;
+    CHECK(quantised.quantiseFrom(trajectory.A));
+    RMSDCalculation rmsd(trajectory);
+    double sameSpheresDifference, maxDifference, maxRelative, maxBound;
+    rmsd.quantisationError(quantised, 16, sameSpheresDifference, maxDifference, maxRelative, maxBound);
+    CHECK(maxBound > 0);
+    CHECK(sameSpheresDifference <= maxBound);
+}
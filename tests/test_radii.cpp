@@ -0,0 +1,66 @@
+#include "../RMSD_calculation.h"
+#include "test.h"
+
+TEST(sphereRadiiParsing) {
+    std::vector<double> radii;
+    CHECK(RMSDCalculation::parseRadii("", 8, radii));
+    CHECK(radii == std::vector<double>({8}));
+    CHECK(RMSDCalculation::parseRadii("10, 6,8,", 8, radii));
+    CHECK(radii == std::vector<double>({6, 8, 10}));
+    CHECK(!RMSDCalculation::parseRadii("6,x", 8, radii));
+    CHECK(!RMSDCalculation::parseRadii("6,10abc", 8, radii));
+    CHECK(!RMSDCalculation::parseRadii("-2", 8, radii));
+    CHECK(!RMSDCalculation::parseRadii("0", 8, radii));
+    CHECK(!RMSDCalculation::parseRadii("", 0, radii));
+    // 8 radii together with sphereRadius are the most one pass scores
+    CHECK(RMSDCalculation::parseRadii("1,2,3,4,5,6,7", 8, radii));
+    CHECK(!RMSDCalculation::parseRadii("1,2,3,4,5,6,7,9", 8, radii));
+}
+
+// value of every radius of one pass equals a search allocating spheres with that radius alone;
+// a resident cache filled by single radius searches is not used by the pass
+TEST(radiiInOnePassMatchSingleRadius) {
+    SyntheticTrajectory synthetic(10, 400);
+    const Trajectory &trajectory = *synthetic.trajectory;
+    omp_thread_id = 0;
+    std::vector<double> radii;
+    CHECK(RMSDCalculation::parseRadii("5,11", 8, radii));
+    std::shared_ptr<ResidentCache> cache = std::make_shared<ResidentCache>(1000, 100);
+    for (int i = 0; i < trajectory.frames; i += 3) {
+        for (int j = 0; j < trajectory.frames; j += 2) {
+            if (i == j) {
+                continue;
+            }
+            std::vector<double> single;
+            for (double radius : radii) {
+                RMSDCalculation rmsd(trajectory);
+                rmsd.setRadii(radius, {radius});
+                rmsd.initThreads(1, 0);
+                rmsd.atomsAllocation(i);
+                single.push_back(rmsd.calculateRMSDSuperpose(j));
+            }
+            // filling the cache with allocations and values of radius 8 only
+            RMSDCalculation cached(trajectory);
+            cached.cache = cache;
+            cached.initThreads(1, 0);
+            cached.atomsAllocation((i + 1) % trajectory.frames);
+            cached.atomsAllocation(i);
+            cached.calculateRMSDSuperpose(j);
+
+            RMSDCalculation pass(trajectory);
+            pass.setRadii(8, radii);
+            pass.cache = cache;
+            pass.initThreads(1, 0);
+            pass.atomsAllocation((i + 1) % trajectory.frames);
+            pass.atomsAllocation(i);
+            CHECK_NEAR(pass.calculateRMSDSuperpose(j), single[1], 1e-9);
+            std::vector<double> values;
+            std::vector<int> bestI, bestJ;
+            pass.radiusMaxima(values, bestI, bestJ);
+            for (size_t r = 0; r < radii.size(); r++) {
+                CHECK_NEAR(values[r], single[r], 1e-9);
+                CHECK(bestI[r] == i && bestJ[r] == j);
+            }
+        }
+    }
+}
@@ -0,0 +1,48 @@
+#include "../RMSD_calculation.h"
+#include "test.h"
+
+// allocations from kept neighbour lists, on their source frames and on other frames within the skin,
+// give the same pair values as a full scan
+TEST(skinListsMatchFullScan) {
+    // frames are the first synthetic frame with small independent jitter, so every frame is within the skin of every other
+    SyntheticTrajectory synthetic(1, 400);
+    const int frames = 12, atoms = 400;
+    std::vector<double> coordinates((size_t)frames * atoms * 3);
+    std::mt19937 random(2);
+    std::normal_distribution<double> normal(0.0, 0.2);
+    for (int f = 0; f < frames; f++) {
+        for (int k = 0; k < atoms * 3; k++) {
+            coordinates[(size_t)f * atoms * 3 + k] = synthetic.coordinates[k] + normal(random);
+        }
+    }
+    std::vector<int> CAAtoms;
+    for (int a = 0; a < atoms; a += 4) {
+        CAAtoms.push_back(a);
+    }
+    Trajectory trajectory;
+    trajectory.borrow(coordinates.data(), frames, atoms, CAAtoms);
+    omp_thread_id = 0;
+
+    RMSDCalculation full(trajectory);
+    full.initThreads(1, 0);
+    RMSDCalculation skin(trajectory);
+    skin.initThreads(1, 4);
+    RMSDCalculation thinSkin(trajectory);
+    thinSkin.initThreads(1, 0.01);
+    int allocations[] = {0, 5, 0, 1, 5, 11, 2, 0, 10, 3, 4, 6, 7, 8, 9, 11, 0};
+    for (int i : allocations) {
+        full.atomsAllocation(i);
+        skin.atomsAllocation(i);
+        thinSkin.atomsAllocation(i);
+        int j = (i + 6) % frames;
+        double value = full.calculateRMSDSuperpose(j);
+        CHECK_NEAR(skin.calculateRMSDSuperpose(j), value, 1e-12);
+        CHECK_NEAR(thinSkin.calculateRMSDSuperpose(j), value, 1e-12);
+    }
+    int reused, rebuilt;
+    skin.skinStats(reused, rebuilt);
+    CHECK(rebuilt == 1 && reused == 16);
+    // only frames coming back while their lists are kept: 0, 5 and 0 again; 11 and the last 0 were evicted
+    thinSkin.skinStats(reused, rebuilt);
+    CHECK(reused == 3 && rebuilt == 14);
+}
@@ -0,0 +1,38 @@
+#include "../top_k.h"
+#include "test.h"
+
+// pairs merged from several threads are sorted, without duplicates, and no two kept pairs have
+// both frames closer than the minimal separation
+TEST(topKPairsSeparated) {
+    const int separation = 5;
+    TopKPairs topK;
+    topK.init(6, separation, 2);
+    std::mt19937 random(3);
+    std::uniform_int_distribution<int> frame(0, 99);
+    std::uniform_real_distribution<double> value(0.0, 10.0);
+    for (int route = 0; route < 50; route++) {
+        for (int thread = 0; thread < 2; thread++) {
+            for (int step = 0; step < 20; step++) {
+                topK.offer(thread, value(random), frame(random), frame(random));
+            }
+            topK.flush(thread);
+        }
+    }
+    // the best pair, offered twice in reversed order, and its neighbours
+    topK.offer(0, 20, 60, 10);
+    topK.offer(1, 19, 10, 60);
+    topK.offer(1, 18, 12, 62);
+    std::vector<TopKPairs::Entry> results = topK.results();
+    CHECK(results.size() == 6);
+    CHECK(results[0].rmsdValue == 20 && results[0].i == 10 && results[0].j == 60);
+    for (size_t a = 0; a < results.size(); a++) {
+        CHECK(results[a].i <= results[a].j);
+        if (a > 0) {
+            CHECK(results[a].rmsdValue <= results[a - 1].rmsdValue);
+        }
+        for (size_t b = a + 1; b < results.size(); b++) {
+            CHECK(std::abs(results[a].i - results[b].i) >= separation || std::abs(results[a].j - results[b].j) >= separation);
+        }
+    }
+    CHECK(results[1].rmsdValue < 18);
+}
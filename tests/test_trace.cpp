@@ -0,0 +1,43 @@
+#include <chrono>
+#include <thread>
+
+#include "../evaluator.h"
+#include "test.h"
+
+// route best improvements above the incumbent reach the incumbent and its trace while the route runs,
+// each with its own timestamp, not one point stamped when the route ends
+TEST(incumbentTraceFollowsRouteBest) {
+    SyntheticTrajectory synthetic(6, 40);
+    Config config;
+    config.initDefault();
+    config.showDebugCurrentBest = false;
+    config.showDebugRouteBest = false;
+    Evaluator evaluator(*synthetic.trajectory, config);
+    omp_thread_id = 0;
+    evaluator.initThreads(1);
+    evaluator.start = std::chrono::steady_clock::now();
+
+    LocalSearchResult routeBest;
+    double values[] = {1.0, 2.0, 1.5, 3.0};
+    for (double value : values) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        evaluator.saveIfRouteBest(routeBest, value, 0, 1);
+    }
+    CHECK(evaluator.bestResult.rmsdValue == 3.0);
+    CHECK(evaluator.incumbentTrace.size() == 3);
+    for (size_t p = 1; p < evaluator.incumbentTrace.size(); p++) {
+        CHECK(evaluator.incumbentTrace[p].seconds >= evaluator.incumbentTrace[p - 1].seconds + 0.004);
+        CHECK(evaluator.incumbentTrace[p].rmsdValue > evaluator.incumbentTrace[p - 1].rmsdValue);
+    }
+    CHECK_NEAR(evaluator.routeGain[0], 3.0, 1e-12);
+
+    // the end of the route adds nothing already published
+    CHECK(evaluator.saveIfBest(routeBest.rmsdValue, routeBest.i, routeBest.j) == 0);
+    CHECK(evaluator.incumbentTrace.size() == 3);
+
+    // a later route best below the incumbent stays in its route
+    LocalSearchResult nextRoute;
+    evaluator.saveIfRouteBest(nextRoute, 2.5, 2, 3);
+    CHECK(evaluator.incumbentTrace.size() == 3);
+    CHECK(evaluator.bestResult.rmsdValue == 3.0);
+}
@@ -0,0 +1,143 @@
+#ifndef TOP_K_H
+#define TOP_K_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+#include <omp.h>
+
+// Bounded set of the K most deviating frame pairs.
+// Every thread offers evaluated pairs to its own small min-heap (no locking on the hot path),
+// local heaps are merged into the shared result under a lock only when flush() is called,
+// which happens once per finished route.
+class TopKPairs {
+  public:
+    struct Entry {
+        double rmsdValue;
+        int i;
+        int j;
+    };
+
+  private:
+    int capacity;
+    int localCapacity;
+    int minSeparation;
+    std::vector<std::vector<Entry>> localHeaps;
+    std::vector<Entry> merged;
+    omp_lock_t mergeMutex;
+
+    static bool greater(const Entry &a, const Entry &b) {
+        return a.rmsdValue > b.rmsdValue;
+    }
+
+    static bool samePair(const Entry &a, const Entry &b) {
+        return a.i == b.i && a.j == b.j;
+    }
+
+    // pairs are neighbours if both frames are closer than minSeparation
+    bool neighbours(const Entry &a, const Entry &b) {
+        return std::abs(a.i - b.i) < minSeparation && std::abs(a.j - b.j) < minSeparation;
+    }
+
+    // keeping best entries only, skipping duplicates and neighbours of already kept pairs
+    void select(std::vector<Entry> &candidates) {
+        std::sort(candidates.begin(), candidates.end(), greater);
+        std::vector<Entry> kept;
+        kept.reserve(capacity);
+        for (const Entry &candidate : candidates) {
+            if ((int)kept.size() == capacity) {
+                break;
+            }
+            bool accepted = true;
+            for (const Entry &k : kept) {
+                if (samePair(k, candidate) || (minSeparation > 0 && neighbours(k, candidate))) {
+                    accepted = false;
+                    break;
+                }
+            }
+            if (accepted) {
+                kept.push_back(candidate);
+            }
+        }
+        candidates.swap(kept);
+    }
+
+  public:
+    TopKPairs() : capacity(1), localCapacity(1), minSeparation(0) {
+        omp_init_lock(&mergeMutex);
+    }
+
+    ~TopKPairs() {
+        omp_destroy_lock(&mergeMutex);
+    }
+
+    void init(int k, int separation, int threads) {
+        capacity = std::max(k, 1);
+        minSeparation = std::max(separation, 0);
+        // neighbours are filtered only while merging, so local heaps keep some spare candidates
+        localCapacity = minSeparation > 0 ? capacity * 4 : capacity;
+        localHeaps.assign(threads, {});
+        for (auto &heap : localHeaps) {
+            heap.reserve(localCapacity);
+        }
+        merged.clear();
+    }
+
+    // pairs are stored as (smaller frame, bigger frame)
+    inline void offer(int thread, double value, int i, int j) {
+        if (value < 0) {
+            return;
+        }
+        std::vector<Entry> &heap = localHeaps[thread];
+        if ((int)heap.size() == localCapacity && value <= heap.front().rmsdValue) {
+            return;
+        }
+        Entry entry = {value, std::min(i, j), std::max(i, j)};
+        for (Entry &e : heap) {
+            if (samePair(e, entry)) {
+                if (value > e.rmsdValue) {
+                    e.rmsdValue = value;
+                    std::make_heap(heap.begin(), heap.end(), greater);
+                }
+                return;
+            }
+        }
+        if ((int)heap.size() == localCapacity) {
+            std::pop_heap(heap.begin(), heap.end(), greater);
+            heap.pop_back();
+        }
+        heap.push_back(entry);
+        std::push_heap(heap.begin(), heap.end(), greater);
+    }
+
+    // merging thread local heap into shared results
+    void flush(int thread) {
+        std::vector<Entry> &heap = localHeaps[thread];
+        if (heap.empty()) {
+            return;
+        }
+        omp_set_lock(&mergeMutex);
+        merged.insert(merged.end(), heap.begin(), heap.end());
+        select(merged);
+        omp_unset_lock(&mergeMutex);
+        heap.clear();
+    }
+
+    // sorted from the most deviating pair
+    std::vector<Entry> results() {
+        for (int t = 0; t < (int)localHeaps.size(); t++) {
+            flush(t);
+        }
+        return merged;
+    }
+
+    // pairs merged so far, safe to call while threads still search
+    std::vector<Entry> snapshot() {
+        omp_set_lock(&mergeMutex);
+        std::vector<Entry> result = merged;
+        omp_unset_lock(&mergeMutex);
+        return result;
+    }
+};
+
+#endif // TOP_K_H
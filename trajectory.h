@@ -0,0 +1,79 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "coordinate_store.h"
+
+// Loaded trajectory, read only while searches run on it.
+struct Trajectory {
+    // Atoms[<frame>][<atom>][<coordinate>]
+    CoordinateStore A;
+
+    // Maps sphere to CA; CAAtomNumber[<sphere>]
+    std::vector<int> sphereCA;
+    // residue number of every sphere's CA, empty if not known
+    std::vector<int> sphereResidues;
+
+    // frames at load time
+    int frames;
+    // selected atoms, the only ones stored
+    int atoms;
+    int spheres;
+    // atoms of a frame in the file, before selection
+    int atomsInFile;
+    std::string selection;
+    // frames searches may read, grows past frames while a followed trajectory is appended;
+    // stored with release after the frame's coordinates are written
+    std::atomic<int> available;
+    // set while a background reader may still publish frames
+    std::atomic<bool> loading;
+    // frames of the file left out because coordinates had no room for them, counted to the end of a file
+    // read in the background; not counted while tailing a file
+    std::atomic<int> framesDropped;
+    // when reading started, and seconds it took once all frames are read
+    std::chrono::steady_clock::time_point loadStart;
+    std::atomic<double> loadSeconds;
+
+    Trajectory()
+        : frames(0), atoms(0), spheres(0), atomsInFile(0), selection("all"), available(0), loading(false), framesDropped(0),
+          loadStart(std::chrono::steady_clock::now()), loadSeconds(0) {}
+
+    // trajectory over coordinates owned by the caller, laid out as [<frame>][<atom>][<coordinate>],
+    // read in place without copying; CAAtoms are atom numbers of sphere centers
+    void borrow(double *coordinates, int framesCount, int atomsCount, const std::vector<int> &CAAtoms) {
+        A.borrow(coordinates, framesCount, atomsCount);
+        frames = framesCount;
+        available = framesCount;
+        atoms = atomsCount;
+        atomsInFile = atomsCount;
+        sphereCA = CAAtoms;
+        spheres = sphereCA.size();
+    }
+
+    // the same for single precision coordinates, which are converted into own store once
+    bool assign(const float *coordinates, int framesCount, int atomsCount, const std::vector<int> &CAAtoms) {
+        if (!A.allocate(framesCount, atomsCount, "none", "none")) {
+            return false;
+        }
+        for (int f = 0; f < framesCount; f++) {
+            for (int a = 0; a < atomsCount; a++) {
+                for (int k = 0; k < 3; k++) {
+                    A[f][a][k] = coordinates[((size_t)f * atomsCount + a) * 3 + k];
+                }
+            }
+        }
+        frames = framesCount;
+        available = framesCount;
+        atoms = atomsCount;
+        atomsInFile = atomsCount;
+        sphereCA = CAAtoms;
+        spheres = sphereCA.size();
+        return true;
+    }
+};
+
+#endif // TRAJECTORY_H
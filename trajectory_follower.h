@@ -0,0 +1,333 @@
+#ifndef TRAJECTORY_FOLLOWER_H
+#define TRAJECTORY_FOLLOWER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "atom_selection.h"
+#include "globals.h"
+#include "trajectory.h"
+
+// Reading a trajectory file on a background thread while searches already run on it: either loading it
+// to the end (pipelined start-up), or tailing a file which is still being written, e.g. by a running simulation.
+// Coordinates are allocated up front for followCapacity frames, or for the frame count estimated
+// from the file size (untouched pages cost nothing), so the store never moves. Every complete frame
+// is parsed into the first unpublished slot and then published through trajectory.available, so running
+// searches pick it up without pausing. A frame is complete at its ENDMDL line, or when the next MODEL starts.
+// Frames of a file read to the end which do not fit the estimate are counted in trajectory.framesDropped.
+class TrajectoryFollower {
+  private:
+    // searches wait for at least this many frames, fewer can't form distinct pairs
+    static const int MIN_FRAMES = 4;
+
+    std::shared_ptr<Trajectory> trajectory;
+    AtomSelection selection;
+    std::ifstream file;
+    // end of the file read so far, without its line break yet
+    std::string partialLine;
+    // slot of the frame being parsed, -1 between frames
+    int frame;
+    // coordinates of the frame being parsed into a quantised store, encoded when it is published
+    std::vector<double> staging;
+    std::atomic<bool> full;
+    // tailing the file after its end, otherwise reading stops there
+    bool tail;
+    double pollSeconds;
+    // bytes up to the end of the first frame, used to estimate number of frames
+    size_t firstFrameBytes;
+    std::thread thread;
+    std::atomic<bool> stopping;
+
+    void publish() {
+        if (frame >= 0) {
+            if (trajectory->A.quantised()) {
+                trajectory->A.setFrame(frame, staging.data());
+            }
+            trajectory->available.store(frame + 1, std::memory_order_release);
+            frame = -1;
+        }
+    }
+
+    void parseLine(const std::string &line) {
+        if (line.empty()) {
+            return;
+        }
+        if (line[0] == 'M') {
+            publish();
+            int next = trajectory->available.load(std::memory_order_relaxed);
+            if (next < trajectory->A.size()) {
+                frame = next;
+            } else {
+                full = true;
+                if (!tail && line.compare(0, 5, "MODEL") == 0) {
+                    trajectory->framesDropped++;
+                }
+            }
+        } else if (line[0] == 'E') {
+            publish();
+        } else if (line[0] == 'A' && frame >= 0 && line.size() >= 54) {
+            int atom = selection.slot(std::stoi(line.substr(6, 5)) - 1);
+            if (atom >= 0) {
+                double *coordinates = trajectory->A.quantised() ? &staging[(size_t)atom * 3] : trajectory->A[frame][atom];
+                coordinates[0] = std::stod(line.substr(30, 8));
+                coordinates[1] = std::stod(line.substr(38, 8));
+                coordinates[2] = std::stod(line.substr(46, 8));
+            }
+        }
+    }
+
+    // selected atoms and CA atoms of the first frame; false if it is not complete yet
+    bool scanFirstFrame(const Config &config) {
+        std::ifstream scan(config.trajectoryFilename);
+        std::string line;
+        std::string error;
+        int models = 0;
+        firstFrameBytes = 0;
+        // parsing again drops slots of an earlier scan of an incomplete frame
+        selection.parse(config.atomSelection, error);
+        trajectory->sphereCA = {};
+        trajectory->sphereResidues = {};
+        while (getline(scan, line)) {
+            if (scan.eof() && tail) {
+                // last line without its line break may still be written
+                break;
+            }
+            firstFrameBytes += line.size() + 1;
+            if (line.empty()) {
+                continue;
+            }
+            if (line[0] == 'M' && ++models == 2) {
+                break;
+            } else if (line[0] == 'E' && models == 1) {
+                models = 2;
+                break;
+            } else if (line[0] == 'A' && models == 1) {
+                int atom = selection.select(line);
+                if (atom >= 0 && line.size() > 14 && line[14] == 'A' and line[13] == 'C') {
+                    trajectory->sphereCA.push_back(atom);
+                    trajectory->sphereResidues.push_back(std::stoi(line.substr(22, 4)));
+                }
+            }
+        }
+        trajectory->atoms = selection.selected();
+        trajectory->atomsInFile = selection.total();
+        trajectory->spheres = trajectory->sphereCA.size();
+        trajectory->selection = config.atomSelection;
+        return models == 2 && trajectory->atoms > 0;
+    }
+
+    // frames after the store is full, counted to the end of the file without parsing them
+    void countDropped() {
+        std::string line;
+        while (!stopping && getline(file, line)) {
+            if (!partialLine.empty()) {
+                line.insert(0, partialLine);
+                partialLine.clear();
+            }
+            if (line.compare(0, 5, "MODEL") == 0) {
+                trajectory->framesDropped++;
+            }
+        }
+    }
+
+    void sleep() {
+        auto until = std::chrono::steady_clock::now() + std::chrono::duration<double>(pollSeconds);
+        while (!stopping && std::chrono::steady_clock::now() < until) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+
+  public:
+    // frames are read to the end of file, on the end of file the last frame is complete
+    void finish() {
+        if (!partialLine.empty()) {
+            try {
+                parseLine(partialLine);
+            } catch (const std::exception &) {
+            }
+            partialLine.clear();
+        }
+        publish();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - trajectory->loadStart;
+        trajectory->loadSeconds = elapsed.count();
+    }
+
+    TrajectoryFollower(std::shared_ptr<Trajectory> trajectory)
+        : trajectory(trajectory), frame(-1), full(false), tail(true), pollSeconds(1), firstFrameBytes(0), stopping(false) {}
+
+    ~TrajectoryFollower() {
+        stop();
+    }
+
+    // allocating coordinates and starting to read the file in the background, tailing it if config.follow is set;
+    // returns 0 as soon as the first MIN_FRAMES frames are read
+    int open(const Config &config) {
+        const std::string &filename = config.trajectoryFilename;
+        tail = config.follow;
+        pollSeconds = std::max(config.followPollSeconds, 0.01);
+        trajectory->loadStart = std::chrono::steady_clock::now();
+        trajectory->loadSeconds = 0;
+        if (!std::ifstream(filename).is_open()) {
+            if (DEBUG) {
+                std::cout << "Cannot find file: " << filename << std::endl;
+            }
+            return 1;
+        }
+        std::string selectionError;
+        if (!selection.parse(config.atomSelection, selectionError)) {
+            if (DEBUG) {
+                std::cout << "Invalid atom selection \"" << config.atomSelection << "\": " << selectionError << std::endl;
+            }
+            return 1;
+        }
+        if (DEBUG) {
+            std::cout << (tail ? "Following file: " : "Reading file in background: ") << filename << std::endl;
+        }
+        while (!scanFirstFrame(config)) {
+            if (!tail) {
+                if (DEBUG) {
+                    std::cout << "No complete frame in file: " << filename << std::endl;
+                }
+                return 1;
+            }
+            sleep();
+        }
+        if (trajectory->sphereCA.empty()) {
+            if (DEBUG) {
+                std::cout << "Atom selection \"" << config.atomSelection << "\" has no CA atoms to center spheres on" << std::endl;
+            }
+            return 1;
+        }
+        // later frames are written only to the primary copy, so replicas would go stale
+        std::string placement = config.numaPlacement == "replicate" ? "interleave" : config.numaPlacement;
+        int capacity = std::max(config.followCapacity, MIN_FRAMES);
+        if (!tail) {
+            // frames of similar size, with a margin for frames longer than the first one
+            std::ifstream sized(filename, std::ios::ate | std::ios::binary);
+            size_t bytes = sized.tellg();
+            capacity = std::max<size_t>(bytes / std::max<size_t>(firstFrameBytes, 1) * 5 / 4 + 16, MIN_FRAMES);
+        }
+        bool quantised = config.coordinatePrecision == "int16";
+        if (!trajectory->A.allocate(capacity, trajectory->atoms, placement, config.hugePages, quantised)) {
+            if (DEBUG) {
+                std::cout << "Cannot allocate coordinates of " << capacity << " frames" << std::endl;
+            }
+            return 1;
+        }
+        staging.assign(quantised ? (size_t)trajectory->atoms * 3 : 0, 0.0);
+        trajectory->available = 0;
+        trajectory->loading = true;
+        file.open(filename);
+        bool finished = false;
+        while (trajectory->available < MIN_FRAMES && !full) {
+            if (poll(MIN_FRAMES) > 0) {
+                continue;
+            }
+            if (!tail) {
+                finish();
+                finished = true;
+                break;
+            }
+            sleep();
+        }
+        if (finished) {
+            trajectory->loading = false;
+        }
+        if (trajectory->available < 2) {
+            if (DEBUG) {
+                std::cout << "Less than 2 frames in file: " << filename << std::endl;
+            }
+            return 1;
+        }
+        trajectory->frames = trajectory->available;
+        if (DEBUG) {
+            std::cout << "Searching from " << trajectory->frames << " frames, " << (tail ? "following" : "reading")
+                      << " up to " << capacity << " frames" << std::endl;
+            std::cout << "Atoms: " << trajectory->atoms << " of " << trajectory->atomsInFile << " selected by \""
+                      << trajectory->selection << "\", " << trajectory->spheres << " spheres" << std::endl;
+        }
+        if (finished) {
+            return 0;
+        }
+        thread = std::thread([this]() {
+            while (!stopping && !full) {
+                if (poll() == 0) {
+                    if (!tail) {
+                        finish();
+                        break;
+                    }
+                    sleep();
+                }
+            }
+            if (full && !tail) {
+                countDropped();
+                finish();
+                if (DEBUG) {
+                    std::cout << "Trajectory has " << trajectory->framesDropped << " frames more than " << trajectory->A.size()
+                              << " estimated from the file size, they are not read" << std::endl;
+                }
+            } else if (full && DEBUG) {
+                std::cout << "Trajectory has more frames than " << trajectory->A.size() << ", the rest is not read" << std::endl;
+            }
+            trajectory->loading = false;
+        });
+        return 0;
+    }
+
+    // reading what was appended since the last call, stopping once untilFrames are published;
+    // returns number of newly published frames
+    int poll(int untilFrames = -1) {
+        int before = trajectory->available.load(std::memory_order_relaxed);
+        char buffer[1 << 16];
+        while (!full && !stopping && (untilFrames < 0 || trajectory->available.load(std::memory_order_relaxed) < untilFrames)) {
+            file.read(buffer, sizeof(buffer));
+            std::streamsize read = file.gcount();
+            if (read <= 0) {
+                break;
+            }
+            const char *begin = buffer;
+            const char *end = buffer + read;
+            for (const char *p = begin; p < end; p++) {
+                if (*p == '\n') {
+                    partialLine.append(begin, p);
+                    try {
+                        parseLine(partialLine);
+                    } catch (const std::exception &) {
+                        // malformed line, skipped
+                    }
+                    partialLine.clear();
+                    begin = p + 1;
+                }
+            }
+            partialLine.append(begin, end);
+        }
+        // end of file only means nothing more was written yet
+        file.clear();
+        return trajectory->available.load(std::memory_order_relaxed) - before;
+    }
+
+    void stop() {
+        stopping = true;
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+
+    bool capacityReached() {
+        return full;
+    }
+
+    // all frames are read, never true while tailing
+    bool complete() {
+        return !trajectory->loading;
+    }
+};
+
+#endif // TRAJECTORY_FOLLOWER_H